@@ -6,6 +6,8 @@
 #include <cstdlib>
 #include <cstdint>
 #include <algorithm>
+#include <stdexcept>
+#include <thread>
 #include "bst.h"
 
 struct KeyError { };
@@ -20,20 +22,21 @@ class AVLNode : public Node<Key, Value>
 {
 public:
     // Constructor/destructor.
-    AVLNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent);
-    virtual ~AVLNode();
+    template<typename K, typename V>
+    AVLNode(K&& key, V&& value, AVLNode<Key, Value>* parent);
+    ~AVLNode();
 
     // Getter/setter for the node's height.
     int8_t getBalance () const;
     void setBalance (int8_t balance);
     void updateBalance(int8_t diff);
 
-    // Getters for parent, left, and right. These need to be redefined since they
+    // Getters for parent, left, and right. These hide the Node versions so they
     // return pointers to AVLNodes - not plain Nodes. See the Node class in bst.h
     // for more information.
-    virtual AVLNode<Key, Value>* getParent() const override;
-    virtual AVLNode<Key, Value>* getLeft() const override;
-    virtual AVLNode<Key, Value>* getRight() const override;
+    AVLNode<Key, Value>* getParent() const;
+    AVLNode<Key, Value>* getLeft() const;
+    AVLNode<Key, Value>* getRight() const;
 
 protected:
     int8_t balance_;    // effectively a signed char
@@ -49,8 +52,9 @@ protected:
 * An explicit constructor to initialize the elements by calling the base class constructor
 */
 template<class Key, class Value>
-AVLNode<Key, Value>::AVLNode(const Key& key, const Value& value, AVLNode<Key, Value> *parent) :
-    Node<Key, Value>(key, value, parent), balance_(0)
+template<typename K, typename V>
+AVLNode<Key, Value>::AVLNode(K&& key, V&& value, AVLNode<Key, Value> *parent) :
+    Node<Key, Value>(std::forward<K>(key), std::forward<V>(value), parent), balance_(0)
 {
 
 }
@@ -92,8 +96,8 @@ void AVLNode<Key, Value>::updateBalance(int8_t diff)
 }
 
 /**
-* An overridden function for getting the parent since a static_cast is necessary to make sure
-* that our node is a AVLNode.
+* A getter for the parent. Every node in an AVLTree is an AVLNode, so the
+* static_cast is free and the call inlines.
 */
 template<class Key, class Value>
 AVLNode<Key, Value> *AVLNode<Key, Value>::getParent() const
@@ -102,7 +106,7 @@ AVLNode<Key, Value> *AVLNode<Key, Value>::getParent() const
 }
 
 /**
-* Overridden for the same reasons as above.
+* Hidden for the same reasons as above.
 */
 template<class Key, class Value>
 AVLNode<Key, Value> *AVLNode<Key, Value>::getLeft() const
@@ -111,7 +115,7 @@ AVLNode<Key, Value> *AVLNode<Key, Value>::getLeft() const
 }
 
 /**
-* Overridden for the same reasons as above.
+* Hidden for the same reasons as above.
 */
 template<class Key, class Value>
 AVLNode<Key, Value> *AVLNode<Key, Value>::getRight() const
@@ -127,127 +131,408 @@ AVLNode<Key, Value> *AVLNode<Key, Value>::getRight() const
 */
 
 
-template <class Key, class Value>
-class AVLTree : public BinarySearchTree<Key, Value>
+template <class Key, class Value, class Compare = std::less<Key>, class Alloc = NodePool>
+class AVLTree : public BinarySearchTree<Key, Value, Compare, Alloc>
 {
 public:
-    virtual void insert (const std::pair<const Key, Value> &new_item); // TODO
+    AVLTree();
+    explicit AVLTree(const Compare& comp);
+    template<typename InputIt>
+    AVLTree(InputIt first, InputIt last, const Compare& comp = Compare());
+    AVLTree(AVLTree&& other);
+    AVLTree& operator=(AVLTree&& other);
+    virtual ~AVLTree();
     virtual void remove(const Key& key);  // TODO
+    void split(const Key& key, AVLTree& right);
+    void join(AVLTree& other);
+    void unite(AVLTree& other);
+    void intersect(const AVLTree& other);
+    void subtract(const AVLTree& other);
+    void uniteParallel(AVLTree& other, unsigned threads = 0);
+    void intersectParallel(const AVLTree& other, unsigned threads = 0);
 protected:
+    virtual Node<Key, Value>* internalInsert(const Key& key, const Value& value, bool overwrite, bool& inserted);
+    virtual Node<Key, Value>* internalInsert(Key&& key, Value&& value, bool overwrite, bool& inserted);
+    template<typename K, typename V>
+    Node<Key, Value>* insertItem(K&& key, V&& value, bool overwrite, bool& inserted);
+    virtual void destroyNode(Node<Key, Value>* n);
+    virtual Node<Key, Value>* createBuiltNode(Alloc& alloc, const Key& key, const Value& value, Node<Key, Value>* parent,
+                                              int8_t balance, int height) const;
+    AVLNode<Key, Value>* root() const;
     virtual void nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2);
 
     // Add helper functions here
-    void rebalance(AVLNode<Key,Value>* node);
+    void insertFix(AVLNode<Key, Value>* p, AVLNode<Key, Value>* n);
+    void removeFix(AVLNode<Key, Value>* n, int8_t diff);
     void rotateRight(AVLNode<Key, Value>* node);
     void rotateLeft(AVLNode<Key, Value>* node);
-    void balanceHelper(AVLNode<Key, Value>* node);
-    int getHeight(AVLNode<Key, Value>* node);
+
+    // Split/join on detached subtrees, whose heights are passed along so
+    // each join costs only the difference in height. root_ is scratch
+    // space while they run.
+    static int subtreeHeight(AVLNode<Key, Value>* n);
+    void takeNodes(AVLTree& other);
+    AVLNode<Key, Value>* joinNodes(AVLNode<Key, Value>* left, int leftHeight, AVLNode<Key, Value>* mid,
+                                   AVLNode<Key, Value>* right, int rightHeight, int& height);
+    AVLNode<Key, Value>* concatNodes(AVLNode<Key, Value>* left, int leftHeight,
+                                     AVLNode<Key, Value>* right, int rightHeight, int& height);
+    void splitNodes(AVLNode<Key, Value>* n, int height, const Key& key,
+                    AVLNode<Key, Value>*& left, int& leftHeight, AVLNode<Key, Value>*& mid,
+                    AVLNode<Key, Value>*& right, int& rightHeight);
+    AVLNode<Key, Value>* uniteNodes(AVLNode<Key, Value>* a, int aHeight, AVLNode<Key, Value>* b, int bHeight, int& height);
+    AVLNode<Key, Value>* intersectNodes(AVLNode<Key, Value>* a, int aHeight, AVLNode<Key, Value>* b, int& height);
+    AVLNode<Key, Value>* subtractNodes(AVLNode<Key, Value>* a, int aHeight, AVLNode<Key, Value>* b, int& height);
+    AVLNode<Key, Value>* uniteNodesParallel(AVLNode<Key, Value>* a, int aHeight, AVLNode<Key, Value>* b, int bHeight,
+                                            int& height, unsigned threads);
+    AVLNode<Key, Value>* intersectNodesParallel(AVLNode<Key, Value>* a, int aHeight, AVLNode<Key, Value>* b,
+                                                int& height, unsigned threads);
+    template<typename RightWork, typename LeftWork>
+    void forkJoin(RightWork rightWork, LeftWork leftWork);
+    // smaller subtrees than this are not worth a thread of their own
+    static const int PARALLEL_MIN_HEIGHT = 14;
 
 
 };
 
-template<class Key, class Value>
-void AVLTree<Key, Value>::insert(const std::pair<const Key, Value>& new_item) {
-    if (BinarySearchTree<Key, Value>::root_ == nullptr) {
-        BinarySearchTree<Key, Value>::root_ = new AVLNode<Key, Value>(new_item.first, new_item.second, nullptr);
-        return;
-    }
-    AVLNode<Key, Value>* current = static_cast<AVLNode<Key, Value>*>(BinarySearchTree<Key, Value>::root_);
+template<class Key, class Value, class Compare, class Alloc>
+AVLTree<Key, Value, Compare, Alloc>::AVLTree()
+{
+
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+AVLTree<Key, Value, Compare, Alloc>::AVLTree(const Compare& comp) :
+    BinarySearchTree<Key, Value, Compare, Alloc>(comp)
+{
+
+}
+
+/*
+ * Range constructor; builds a perfectly balanced tree with its balances
+ * already set. See BinarySearchTree::assign().
+ */
+template<class Key, class Value, class Compare, class Alloc>
+template<typename InputIt>
+AVLTree<Key, Value, Compare, Alloc>::AVLTree(InputIt first, InputIt last, const Compare& comp) :
+    BinarySearchTree<Key, Value, Compare, Alloc>(comp)
+{
+    this->assign(first, last);
+}
+
+/*
+ * Move constructor; takes over other's nodes in O(1) and leaves other empty.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+AVLTree<Key, Value, Compare, Alloc>::AVLTree(AVLTree&& other) :
+    BinarySearchTree<Key, Value, Compare, Alloc>(std::move(other))
+{
+
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+AVLTree<Key, Value, Compare, Alloc>& AVLTree<Key, Value, Compare, Alloc>::operator=(AVLTree&& other)
+{
+    BinarySearchTree<Key, Value, Compare, Alloc>::operator=(std::move(other));
+    return *this;
+}
+
+/*
+ * Clears here rather than in ~BinarySearchTree so nodes are released
+ * through the AVLNode version of destroyNode.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+AVLTree<Key, Value, Compare, Alloc>::~AVLTree()
+{
+    this->clear();
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+void AVLTree<Key, Value, Compare, Alloc>::destroyNode(Node<Key, Value>* n)
+{
+    this->destroyNodeAs(static_cast<AVLNode<Key, Value>*>(n));
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+Node<Key, Value>* AVLTree<Key, Value, Compare, Alloc>::createBuiltNode(
+    Alloc& alloc, const Key& key, const Value& value, Node<Key, Value>* parent, int8_t balance, int) const
+{
+    AVLNode<Key, Value>* n = this->template constructNode<AVLNode<Key, Value> >(
+        alloc, key, value, static_cast<AVLNode<Key, Value>*>(parent));
+    n->setBalance(balance);
+    return n;
+}
+
+/*
+ * The root as an AVLNode; every node in this tree is one.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+AVLNode<Key, Value>* AVLTree<Key, Value, Compare, Alloc>::root() const
+{
+    return static_cast<AVLNode<Key, Value>*>(this->root_);
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+Node<Key, Value>* AVLTree<Key, Value, Compare, Alloc>::internalInsert(
+    const Key& key, const Value& value, bool overwrite, bool& inserted) {
+    return insertItem(key, value, overwrite, inserted);
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+Node<Key, Value>* AVLTree<Key, Value, Compare, Alloc>::internalInsert(
+    Key&& key, Value&& value, bool overwrite, bool& inserted) {
+    return insertItem(std::move(key), std::move(value), overwrite, inserted);
+}
+
+/*
+ * Single descent shared by insert, insert_or_assign, try_emplace and
+ * emplace. An existing key only has its value overwritten when overwrite
+ * is set; key and value are forwarded into the node otherwise.
+ *
+ * Balances are maintained incrementally (balance = height(right) - height(left)),
+ * so only the nodes on the path whose height actually changed are touched.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+template<typename K, typename V>
+Node<Key, Value>* AVLTree<Key, Value, Compare, Alloc>::insertItem(
+    K&& key, V&& value, bool overwrite, bool& inserted) {
+    AVLNode<Key, Value>* current = root();
     AVLNode<Key, Value>* parent = nullptr;
+    bool goLeft = false;
     while (current != nullptr) {
+        this->count(OperationCounts::NODES_VISITED);
         parent = current;
-        if (new_item.first < current->getKey()) {
+        int c = this->compareKeys(key, current->getKey());
+        if (c < 0) {
+            goLeft = true;
             current = current->getLeft();
-        } else if (new_item.first > current->getKey()) {
+        } else if (c > 0) {
+            goLeft = false;
             current = current->getRight();
         } else {
-            current->setValue(new_item.second);
-            return;
+            if (overwrite) {
+                current->setValue(std::forward<V>(value));
+            }
+            inserted = false;
+            return current;
         }
     }
-    AVLNode<Key, Value>* newNode = new AVLNode<Key, Value>(new_item.first, new_item.second, parent);
-    if (new_item.first < parent->getKey()) {
+    inserted = true;
+    AVLNode<Key, Value>* newNode = this->template createNode<AVLNode<Key, Value> >(
+        std::forward<K>(key), std::forward<V>(value), parent);
+    if (parent == nullptr) {
+        BinarySearchTree<Key, Value, Compare, Alloc>::root_ = newNode;
+        return newNode;
+    }
+    if (goLeft) {
         parent->setLeft(newNode);
+        parent->updateBalance(-1);
     } else {
         parent->setRight(newNode);
+        parent->updateBalance(1);
+    }
+    this->adjustPathSizes(parent, 1);
+    // parent was a leaf, so its height grew and the change must propagate
+    if (parent->getBalance() != 0) {
+        insertFix(parent, newNode);
     }
-    balanceHelper(parent);
-    rebalance(parent);
+    return newNode;
 }
 
-
-
 /*
- * Recall: If key is already in the tree, you should 
- * overwrite the current value with the updated value.
+ * Called after the subtree rooted at p grew by one level because of
+ * its child n.  Walks up until the growth is absorbed or a rotation
+ * restores the original height.
  */
-template<class Key, class Value>
-void AVLTree<Key, Value>::rebalance(AVLNode<Key, Value>* node) {
-    if (node == nullptr) {
+template<class Key, class Value, class Compare, class Alloc>
+void AVLTree<Key, Value, Compare, Alloc>::insertFix(AVLNode<Key, Value>* p, AVLNode<Key, Value>* n) {
+    AVLNode<Key, Value>* g = (p == nullptr) ? nullptr : p->getParent();
+    if (g == nullptr) {
         return;
     }
-    int balance = node->getBalance();
-    if (balance < -1) {
-        if (node->getLeft()->getBalance() < 0) {
-            rotateRight(node);
+    if (p == g->getLeft()) {
+        g->updateBalance(-1);
+        if (g->getBalance() == 0) {
+            return;
         }
-        else {
-            rotateLeft(node->getLeft());
-            rotateRight(node);
+        if (g->getBalance() == -1) {
+            insertFix(g, p);
+            return;
         }
-    }
-    else if (balance > 1) {
-        if (node->getRight()->getBalance() > 0) {
-            rotateLeft(node);
+        if (n == p->getLeft()) {
+            rotateRight(g);
+            p->setBalance(0);
+            g->setBalance(0);
+        } else {
+            rotateLeft(p);
+            rotateRight(g);
+            if (n->getBalance() == -1) {
+                p->setBalance(0);
+                g->setBalance(1);
+            } else if (n->getBalance() == 0) {
+                p->setBalance(0);
+                g->setBalance(0);
+            } else {
+                p->setBalance(-1);
+                g->setBalance(0);
+            }
+            n->setBalance(0);
         }
-        else {
-            rotateRight(node->getRight());
-            rotateLeft(node);
+    } else {
+        g->updateBalance(1);
+        if (g->getBalance() == 0) {
+            return;
+        }
+        if (g->getBalance() == 1) {
+            insertFix(g, p);
+            return;
+        }
+        if (n == p->getRight()) {
+            rotateLeft(g);
+            p->setBalance(0);
+            g->setBalance(0);
+        } else {
+            rotateRight(p);
+            rotateLeft(g);
+            if (n->getBalance() == 1) {
+                p->setBalance(0);
+                g->setBalance(-1);
+            } else if (n->getBalance() == 0) {
+                p->setBalance(0);
+                g->setBalance(0);
+            } else {
+                p->setBalance(1);
+                g->setBalance(0);
+            }
+            n->setBalance(0);
         }
-    }
-    balanceHelper(node);
-    AVLNode<Key, Value>* parent = node->getParent();
-    if (parent != nullptr) {
-        rebalance(parent);
     }
 }
 
 
-
-
-
-
 /*
  * Recall: The writeup specifies that if a node has 2 children you
  * should swap with the predecessor and then remove.
  */
-template<class Key, class Value>
-void AVLTree<Key, Value>::remove(const Key& key) {
-    AVLNode<Key, Value>* nodeToRemove = static_cast<AVLNode<Key, Value>*>(BinarySearchTree<Key, Value>::internalFind(key));
+template<class Key, class Value, class Compare, class Alloc>
+void AVLTree<Key, Value, Compare, Alloc>::remove(const Key& key) {
+    AVLNode<Key, Value>* nodeToRemove = static_cast<AVLNode<Key, Value>*>(this->internalFind(key));
     if (nodeToRemove == nullptr) {
         return;
     }
+    if (nodeToRemove->getLeft() != nullptr && nodeToRemove->getRight() != nullptr) {
+        AVLNode<Key, Value>* pred = static_cast<AVLNode<Key, Value>*>(this->predecessor(nodeToRemove));
+        nodeSwap(nodeToRemove, pred);
+    }
+    AVLNode<Key, Value>* child = (nodeToRemove->getLeft() != nullptr) ? nodeToRemove->getLeft() : nodeToRemove->getRight();
     AVLNode<Key, Value>* parent = nodeToRemove->getParent();
-    AVLNode<Key, Value>* pred = static_cast<AVLNode<Key, Value>*>(BinarySearchTree<Key, Value>::predecessor(nodeToRemove));
-    BinarySearchTree<Key, Value>::remove(key);
-    if (parent == nullptr){
-      balanceHelper(pred);
-      rebalance(pred);
-    }else{
-      balanceHelper(parent);
-      rebalance(parent);
+    int8_t diff = 0;
+    if (child != nullptr) {
+        child->setParent(parent);
     }
-    if ((nodeToRemove == static_cast<AVLNode<Key, Value>*>(BinarySearchTree<Key, Value>::root_)) && (getHeight(nodeToRemove) == 0)) {
-        BinarySearchTree<Key, Value>::root_ = nullptr;
+    if (parent == nullptr) {
+        BinarySearchTree<Key, Value, Compare, Alloc>::root_ = child;
+    } else if (parent->getLeft() == nodeToRemove) {
+        parent->setLeft(child);
+        diff = 1;
+    } else {
+        parent->setRight(child);
+        diff = -1;
+    }
+    this->adjustPathSizes(parent, -1);
+    this->destroyNode(nodeToRemove);
+    removeFix(parent, diff);
+}
+
+/*
+ * Called after one side of n became one level shorter.  diff is +1 if
+ * the left subtree shrank and -1 if the right subtree shrank.  Stops as
+ * soon as the height of n's subtree is unchanged.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+void AVLTree<Key, Value, Compare, Alloc>::removeFix(AVLNode<Key, Value>* n, int8_t diff) {
+    if (n == nullptr) {
+        return;
+    }
+    // compute the next step before any rotation moves n
+    AVLNode<Key, Value>* p = n->getParent();
+    int8_t ndiff = 0;
+    if (p != nullptr) {
+        ndiff = (n == p->getLeft()) ? 1 : -1;
+    }
+    int balance = n->getBalance() + diff;
+
+    if (balance == -2) {
+        AVLNode<Key, Value>* c = n->getLeft();
+        if (c->getBalance() == -1) {
+            rotateRight(n);
+            n->setBalance(0);
+            c->setBalance(0);
+            removeFix(p, ndiff);
+        } else if (c->getBalance() == 0) {
+            rotateRight(n);
+            n->setBalance(-1);
+            c->setBalance(1);
+        } else {
+            AVLNode<Key, Value>* g = c->getRight();
+            rotateLeft(c);
+            rotateRight(n);
+            if (g->getBalance() == 1) {
+                n->setBalance(0);
+                c->setBalance(-1);
+            } else if (g->getBalance() == 0) {
+                n->setBalance(0);
+                c->setBalance(0);
+            } else {
+                n->setBalance(1);
+                c->setBalance(0);
+            }
+            g->setBalance(0);
+            removeFix(p, ndiff);
+        }
+    } else if (balance == 2) {
+        AVLNode<Key, Value>* c = n->getRight();
+        if (c->getBalance() == 1) {
+            rotateLeft(n);
+            n->setBalance(0);
+            c->setBalance(0);
+            removeFix(p, ndiff);
+        } else if (c->getBalance() == 0) {
+            rotateLeft(n);
+            n->setBalance(1);
+            c->setBalance(-1);
+        } else {
+            AVLNode<Key, Value>* g = c->getLeft();
+            rotateRight(c);
+            rotateLeft(n);
+            if (g->getBalance() == -1) {
+                n->setBalance(0);
+                c->setBalance(1);
+            } else if (g->getBalance() == 0) {
+                n->setBalance(0);
+                c->setBalance(0);
+            } else {
+                n->setBalance(-1);
+                c->setBalance(0);
+            }
+            g->setBalance(0);
+            removeFix(p, ndiff);
+        }
+    } else if (balance == 0) {
+        // n got shorter, so keep going up
+        n->setBalance(0);
+        removeFix(p, ndiff);
+    } else {
+        // n kept its height
+        n->setBalance(balance);
     }
 }
 
 
 
-template<class Key, class Value>
-void AVLTree<Key, Value>::nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2)
+template<class Key, class Value, class Compare, class Alloc>
+void AVLTree<Key, Value, Compare, Alloc>::nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2)
 {
-    BinarySearchTree<Key, Value>::nodeSwap(n1, n2);
+    BinarySearchTree<Key, Value, Compare, Alloc>::nodeSwap(n1, n2);
     int8_t tempB = n1->getBalance();
     n1->setBalance(n2->getBalance());
     n2->setBalance(tempB);
@@ -256,9 +541,14 @@ void AVLTree<Key, Value>::nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>*
 
 
 
-template<class Key, class Value>
-void AVLTree<Key, Value>::rotateLeft(AVLNode<Key, Value>* node) {
+/*
+ * Rotations only relink pointers (and fix subtree sizes); the callers in
+ * insertFix/removeFix know the resulting balances and set them directly.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+void AVLTree<Key, Value, Compare, Alloc>::rotateLeft(AVLNode<Key, Value>* node) {
     if (node == nullptr || node->getRight() == nullptr) return;
+    this->count(OperationCounts::ROTATIONS);
 
     AVLNode<Key, Value>* rightChild = node->getRight();
     AVLNode<Key, Value>* leftOfRight = rightChild->getLeft();
@@ -272,24 +562,24 @@ void AVLTree<Key, Value>::rotateLeft(AVLNode<Key, Value>* node) {
 
     rightChild->setParent(node->getParent());
     if (node->getParent() == nullptr) {
-        BinarySearchTree<Key, Value>::root_ = rightChild;
+        BinarySearchTree<Key, Value, Compare, Alloc>::root_ = rightChild;
     } else if (node == node->getParent()->getLeft()) {
         node->getParent()->setLeft(rightChild);
     } else {
         node->getParent()->setRight(rightChild);
     }
     node->setParent(rightChild);
-
-
-    balanceHelper(node);
+    this->resetSize(node);
+    this->resetSize(rightChild);
 }
 
 
 
 
-template<class Key, class Value>
-void AVLTree<Key, Value>::rotateRight(AVLNode<Key, Value>* node) {
+template<class Key, class Value, class Compare, class Alloc>
+void AVLTree<Key, Value, Compare, Alloc>::rotateRight(AVLNode<Key, Value>* node) {
     if (node == nullptr || node->getLeft() == nullptr) return;
+    this->count(OperationCounts::ROTATIONS);
 
     AVLNode<Key, Value>* leftChild = node->getLeft();
     AVLNode<Key, Value>* rightOfLeft = leftChild->getRight();
@@ -303,41 +593,540 @@ void AVLTree<Key, Value>::rotateRight(AVLNode<Key, Value>* node) {
 
     leftChild->setParent(node->getParent());
     if (node->getParent() == nullptr) {
-        BinarySearchTree<Key, Value>::root_ = leftChild;
+        BinarySearchTree<Key, Value, Compare, Alloc>::root_ = leftChild;
     } else if (node == node->getParent()->getLeft()) {
         node->getParent()->setLeft(leftChild);
     } else {
         node->getParent()->setRight(leftChild);
     }
     node->setParent(leftChild);
+    this->resetSize(node);
+    this->resetSize(leftChild);
+}
+
+/*
+ * Moves every key not less than key into right, replacing what right
+ * held, and keeps the smaller keys. O(log n): the search path is cut
+ * out and the subtrees hanging off it are joined back up on each side.
+ * Without BST_SUBTREE_SIZE the next size() on either tree recounts.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+void AVLTree<Key, Value, Compare, Alloc>::split(const Key& key, AVLTree& right) {
+    if (&right == this) {
+        return;
+    }
+    right.clear();
+    this->alloc_.share(right.alloc_);
+    AVLNode<Key, Value>* less = nullptr;
+    AVLNode<Key, Value>* mid = nullptr;
+    AVLNode<Key, Value>* notLess = nullptr;
+    int lessHeight = 0;
+    int notLessHeight = 0;
+    splitNodes(root(), subtreeHeight(root()), key, less, lessHeight, mid, notLess, notLessHeight);
+    if (mid != nullptr) {
+        notLess = joinNodes(nullptr, 0, mid, notLess, notLessHeight, notLessHeight);
+    }
+    BinarySearchTree<Key, Value, Compare, Alloc>::root_ = less;
+    right.BinarySearchTree<Key, Value, Compare, Alloc>::root_ = notLess;
+    this->invalidateCount();
+    right.invalidateCount();
+}
+
+/*
+ * Moves every item of other into this tree and leaves other empty. All
+ * keys of one tree must be less than all keys of the other (either way
+ * round); otherwise std::invalid_argument is thrown and nothing changes.
+ * O(log n).
+ */
+template<class Key, class Value, class Compare, class Alloc>
+void AVLTree<Key, Value, Compare, Alloc>::join(AVLTree& other) {
+    if (&other == this || other.empty()) {
+        return;
+    }
+    if (this->empty()) {
+        takeNodes(other);
+        return;
+    }
+    bool otherAbove = this->keyLess(this->getLargestNode()->getKey(), other.getSmallestNode()->getKey());
+    if (!otherAbove && !this->keyLess(other.getLargestNode()->getKey(), this->getSmallestNode()->getKey())) {
+        throw std::invalid_argument("join: key ranges overlap");
+    }
+    AVLNode<Key, Value>* mine = root();
+    AVLNode<Key, Value>* theirs = other.root();
+    takeNodes(other);
+    int height = 0;
+    if (otherAbove) {
+        BinarySearchTree<Key, Value, Compare, Alloc>::root_ = concatNodes(mine, subtreeHeight(mine), theirs, subtreeHeight(theirs), height);
+    } else {
+        BinarySearchTree<Key, Value, Compare, Alloc>::root_ = concatNodes(theirs, subtreeHeight(theirs), mine, subtreeHeight(mine), height);
+    }
+}
 
-    balanceHelper(node);
+/*
+ * Moves the items of other whose keys are not already here into this
+ * tree and leaves other empty; for shared keys this tree's value wins.
+ * O(m log(n/m + 1)) for trees of sizes m <= n, by splitting other
+ * around each root of this tree and joining the halves back.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+void AVLTree<Key, Value, Compare, Alloc>::unite(AVLTree& other) {
+    if (&other == this) {
+        return;
+    }
+    AVLNode<Key, Value>* mine = root();
+    AVLNode<Key, Value>* theirs = other.root();
+    takeNodes(other);
+    int height = 0;
+    BinarySearchTree<Key, Value, Compare, Alloc>::root_ =
+        uniteNodes(mine, subtreeHeight(mine), theirs, subtreeHeight(theirs), height);
 }
 
+/*
+ * Removes the items whose keys are not in other. other is unchanged.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+void AVLTree<Key, Value, Compare, Alloc>::intersect(const AVLTree& other) {
+    if (&other == this) {
+        return;
+    }
+    int height = 0;
+    BinarySearchTree<Key, Value, Compare, Alloc>::root_ = intersectNodes(root(), subtreeHeight(root()), other.root(), height);
+}
 
+/*
+ * Removes the items whose keys are in other. other is unchanged.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+void AVLTree<Key, Value, Compare, Alloc>::subtract(const AVLTree& other) {
+    if (&other == this) {
+        this->clear();
+        return;
+    }
+    int height = 0;
+    BinarySearchTree<Key, Value, Compare, Alloc>::root_ = subtractNodes(root(), subtreeHeight(root()), other.root(), height);
+}
 
-template<class Key, class Value>
-void AVLTree<Key, Value>::balanceHelper(AVLNode<Key, Value>* node) {
-    while (node != nullptr) {
-        int leftHeight = getHeight(node->getLeft());
-        int rightHeight = getHeight(node->getRight());
-        int balance = rightHeight - leftHeight;
-        node->setBalance(balance);
-        node = node->getParent();
+/*
+ * Height of a subtree in O(height): the balance says which child is taller.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+int AVLTree<Key, Value, Compare, Alloc>::subtreeHeight(AVLNode<Key, Value>* n) {
+    int height = 0;
+    while (n != nullptr) {
+        ++height;
+        n = (n->getBalance() < 0) ? n->getLeft() : n->getRight();
     }
+    return height;
 }
 
+/*
+ * Takes over the node count and allocator blocks of other, whose nodes
+ * the caller is about to link into this tree, and leaves other empty.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+void AVLTree<Key, Value, Compare, Alloc>::takeNodes(AVLTree& other) {
+    this->alloc_.share(other.alloc_);
+    this->nodeCount_ += other.nodeCount_;
+    this->countStale_ = this->countStale_ || other.countStale_;
+    if (this->empty()) {
+        BinarySearchTree<Key, Value, Compare, Alloc>::root_ = other.root_;
+    }
+    other.BinarySearchTree<Key, Value, Compare, Alloc>::root_ = nullptr;
+    other.nodeCount_ = 0;
+    other.countStale_ = false;
+}
+
+/*
+ * Joins left, mid and right, where every key in left is below mid's and
+ * every key in right above it, into one AVL subtree and returns its
+ * root; height receives its height. mid must be detached. When the
+ * heights differ by more than one, mid goes in on the taller tree's
+ * inner spine where the heights match, and insertFix absorbs the extra
+ * level exactly as it does for an insert. O(|leftHeight - rightHeight| + 1).
+ */
+template<class Key, class Value, class Compare, class Alloc>
+AVLNode<Key, Value>* AVLTree<Key, Value, Compare, Alloc>::joinNodes(
+    AVLNode<Key, Value>* left, int leftHeight, AVLNode<Key, Value>* mid,
+    AVLNode<Key, Value>* right, int rightHeight, int& height) {
+    if (leftHeight <= rightHeight + 1 && rightHeight <= leftHeight + 1) {
+        mid->setParent(nullptr);
+        mid->setLeft(left);
+        mid->setRight(right);
+        if (left != nullptr) {
+            left->setParent(mid);
+        }
+        if (right != nullptr) {
+            right->setParent(mid);
+        }
+        mid->setBalance(rightHeight - leftHeight);
+        this->resetSize(mid);
+        height = std::max(leftHeight, rightHeight) + 1;
+        return mid;
+    }
+    bool leftTaller = leftHeight > rightHeight;
+    AVLNode<Key, Value>* tall = leftTaller ? left : right;
+    int shortHeight = leftTaller ? rightHeight : leftHeight;
+    // walk the inner spine of the taller tree down to a subtree c of
+    // height shortHeight or shortHeight + 1; mid takes its place
+    AVLNode<Key, Value>* attachAt = nullptr;
+    AVLNode<Key, Value>* c = tall;
+    int cHeight = leftTaller ? leftHeight : rightHeight;
+    while (cHeight > shortHeight + 1) {
+        this->count(OperationCounts::NODES_VISITED);
+        attachAt = c;
+        if (leftTaller) {
+            cHeight -= (c->getBalance() < 0) ? 2 : 1;
+            c = c->getRight();
+        } else {
+            cHeight -= (c->getBalance() > 0) ? 2 : 1;
+            c = c->getLeft();
+        }
+    }
+    if (leftTaller) {
+        mid->setLeft(c);
+        mid->setRight(right);
+        attachAt->setRight(mid);
+        mid->setBalance(rightHeight - cHeight);
+    } else {
+        mid->setLeft(left);
+        mid->setRight(c);
+        attachAt->setLeft(mid);
+        mid->setBalance(cHeight - leftHeight);
+    }
+    mid->setParent(attachAt);
+    if (mid->getLeft() != nullptr) {
+        mid->getLeft()->setParent(mid);
+    }
+    if (mid->getRight() != nullptr) {
+        mid->getRight()->setParent(mid);
+    }
+    for (AVLNode<Key, Value>* a = mid; a != nullptr; a = a->getParent()) {
+        this->resetSize(a);
+    }
+
+    BinarySearchTree<Key, Value, Compare, Alloc>::root_ = tall;
+    int8_t oldBalance = tall->getBalance();
+    // mid's subtree is one level taller than c was; c is the child that grew
+    insertFix(mid, c);
+    int tallHeight = leftTaller ? leftHeight : rightHeight;
+    bool grew = root() == tall && oldBalance == 0 && tall->getBalance() != 0;
+    height = tallHeight + (grew ? 1 : 0);
+    return root();
+}
 
+/*
+ * Joins left and right, every key in left being below every key in
+ * right, by removing the largest node of left and using it as the middle.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+AVLNode<Key, Value>* AVLTree<Key, Value, Compare, Alloc>::concatNodes(
+    AVLNode<Key, Value>* left, int leftHeight, AVLNode<Key, Value>* right, int rightHeight, int& height) {
+    if (left == nullptr) {
+        height = rightHeight;
+        return right;
+    }
+    if (right == nullptr) {
+        height = leftHeight;
+        return left;
+    }
+    BinarySearchTree<Key, Value, Compare, Alloc>::root_ = left;
+    AVLNode<Key, Value>* largest = left;
+    while (largest->getRight() != nullptr) {
+        largest = largest->getRight();
+    }
+    AVLNode<Key, Value>* parent = largest->getParent();
+    AVLNode<Key, Value>* child = largest->getLeft();
+    if (child != nullptr) {
+        child->setParent(parent);
+    }
+    if (parent == nullptr) {
+        BinarySearchTree<Key, Value, Compare, Alloc>::root_ = child;
+    } else {
+        parent->setRight(child);
+    }
+    this->adjustPathSizes(parent, -1);
+    removeFix(parent, -1);
+    largest->setLeft(nullptr);
+    largest->setParent(nullptr);
+    AVLNode<Key, Value>* rest = root();
+    return joinNodes(rest, subtreeHeight(rest), largest, right, rightHeight, height);
+}
 
-template<class Key, class Value>
-int AVLTree<Key, Value>::getHeight(AVLNode<Key, Value>* node) {
-    if (node == nullptr) {
-        return 0;
+/*
+ * Cuts the detached subtree n, of the given height, into the keys below
+ * key (left), the node holding key if any (mid, detached) and the keys
+ * above it (right).
+ */
+template<class Key, class Value, class Compare, class Alloc>
+void AVLTree<Key, Value, Compare, Alloc>::splitNodes(
+    AVLNode<Key, Value>* n, int height, const Key& key,
+    AVLNode<Key, Value>*& left, int& leftHeight, AVLNode<Key, Value>*& mid,
+    AVLNode<Key, Value>*& right, int& rightHeight) {
+    if (n == nullptr) {
+        left = mid = right = nullptr;
+        leftHeight = rightHeight = 0;
+        return;
+    }
+    AVLNode<Key, Value>* l = n->getLeft();
+    AVLNode<Key, Value>* r = n->getRight();
+    int lHeight = height - ((n->getBalance() > 0) ? 2 : 1);
+    int rHeight = height - ((n->getBalance() < 0) ? 2 : 1);
+    if (l != nullptr) {
+        l->setParent(nullptr);
     }
-    int leftHeight = getHeight(node->getLeft());
-    int rightHeight = getHeight(node->getRight());
+    if (r != nullptr) {
+        r->setParent(nullptr);
+    }
+    n->setLeft(nullptr);
+    n->setRight(nullptr);
+    n->setParent(nullptr);
+    this->count(OperationCounts::NODES_VISITED);
+    int c = this->compareKeys(key, n->getKey());
+    if (c < 0) {
+        splitNodes(l, lHeight, key, left, leftHeight, mid, right, rightHeight);
+        right = joinNodes(right, rightHeight, n, r, rHeight, rightHeight);
+    } else if (c > 0) {
+        splitNodes(r, rHeight, key, left, leftHeight, mid, right, rightHeight);
+        left = joinNodes(l, lHeight, n, left, leftHeight, leftHeight);
+    } else {
+        left = l;
+        leftHeight = lHeight;
+        right = r;
+        rightHeight = rHeight;
+        n->setBalance(0);
+        this->resetSize(n);
+        mid = n;
+    }
+}
+
+/*
+ * Union of the detached subtrees a and b, keeping a's node for a key in
+ * both and destroying b's.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+AVLNode<Key, Value>* AVLTree<Key, Value, Compare, Alloc>::uniteNodes(
+    AVLNode<Key, Value>* a, int aHeight, AVLNode<Key, Value>* b, int bHeight, int& height) {
+    if (a == nullptr) {
+        height = bHeight;
+        return b;
+    }
+    if (b == nullptr) {
+        height = aHeight;
+        return a;
+    }
+    AVLNode<Key, Value>* bLeft;
+    AVLNode<Key, Value>* bMid;
+    AVLNode<Key, Value>* bRight;
+    int bLeftHeight, bRightHeight;
+    splitNodes(b, bHeight, a->getKey(), bLeft, bLeftHeight, bMid, bRight, bRightHeight);
+    if (bMid != nullptr) {
+        this->destroyNode(bMid);
+    }
+    AVLNode<Key, Value>* aLeft = a->getLeft();
+    AVLNode<Key, Value>* aRight = a->getRight();
+    int aLeftHeight = aHeight - ((a->getBalance() > 0) ? 2 : 1);
+    int aRightHeight = aHeight - ((a->getBalance() < 0) ? 2 : 1);
+    if (aLeft != nullptr) {
+        aLeft->setParent(nullptr);
+    }
+    if (aRight != nullptr) {
+        aRight->setParent(nullptr);
+    }
+    int leftHeight, rightHeight;
+    AVLNode<Key, Value>* left = uniteNodes(aLeft, aLeftHeight, bLeft, bLeftHeight, leftHeight);
+    AVLNode<Key, Value>* right = uniteNodes(aRight, aRightHeight, bRight, bRightHeight, rightHeight);
+    return joinNodes(left, leftHeight, a, right, rightHeight, height);
+}
+
+/*
+ * The part of the detached subtree a whose keys are also in b; the rest
+ * of a is destroyed. b is only read.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+AVLNode<Key, Value>* AVLTree<Key, Value, Compare, Alloc>::intersectNodes(
+    AVLNode<Key, Value>* a, int aHeight, AVLNode<Key, Value>* b, int& height) {
+    if (a == nullptr || b == nullptr) {
+        this->clearHelper(a);
+        height = 0;
+        return nullptr;
+    }
+    AVLNode<Key, Value>* aLeft;
+    AVLNode<Key, Value>* aMid;
+    AVLNode<Key, Value>* aRight;
+    int aLeftHeight, aRightHeight;
+    splitNodes(a, aHeight, b->getKey(), aLeft, aLeftHeight, aMid, aRight, aRightHeight);
+    int leftHeight, rightHeight;
+    AVLNode<Key, Value>* left = intersectNodes(aLeft, aLeftHeight, b->getLeft(), leftHeight);
+    AVLNode<Key, Value>* right = intersectNodes(aRight, aRightHeight, b->getRight(), rightHeight);
+    if (aMid != nullptr) {
+        return joinNodes(left, leftHeight, aMid, right, rightHeight, height);
+    }
+    return concatNodes(left, leftHeight, right, rightHeight, height);
+}
+
+/*
+ * The part of the detached subtree a whose keys are not in b; the rest
+ * of a is destroyed. b is only read.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+AVLNode<Key, Value>* AVLTree<Key, Value, Compare, Alloc>::subtractNodes(
+    AVLNode<Key, Value>* a, int aHeight, AVLNode<Key, Value>* b, int& height) {
+    if (a == nullptr || b == nullptr) {
+        height = aHeight;
+        return a;
+    }
+    AVLNode<Key, Value>* aLeft;
+    AVLNode<Key, Value>* aMid;
+    AVLNode<Key, Value>* aRight;
+    int aLeftHeight, aRightHeight;
+    splitNodes(a, aHeight, b->getKey(), aLeft, aLeftHeight, aMid, aRight, aRightHeight);
+    if (aMid != nullptr) {
+        this->destroyNode(aMid);
+    }
+    int leftHeight, rightHeight;
+    AVLNode<Key, Value>* left = subtractNodes(aLeft, aLeftHeight, b->getLeft(), leftHeight);
+    AVLNode<Key, Value>* right = subtractNodes(aRight, aRightHeight, b->getRight(), rightHeight);
+    return concatNodes(left, leftHeight, right, rightHeight, height);
+}
+
+/*
+ * unite() with the two halves of every split handed to different
+ * threads (all hardware threads when threads is 0). Each thread works on
+ * a helper tree whose allocator is shared with this one, since the
+ * split/join helpers use the tree's root as scratch space.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+void AVLTree<Key, Value, Compare, Alloc>::uniteParallel(AVLTree& other, unsigned threads) {
+    if (&other == this) {
+        return;
+    }
+    AVLNode<Key, Value>* mine = root();
+    AVLNode<Key, Value>* theirs = other.root();
+    takeNodes(other);
+    int height = 0;
+    BinarySearchTree<Key, Value, Compare, Alloc>::root_ = uniteNodesParallel(
+        mine, subtreeHeight(mine), theirs, subtreeHeight(theirs), height, this->threadCount(threads));
+}
+
+/*
+ * intersect() spread over threads the same way as uniteParallel.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+void AVLTree<Key, Value, Compare, Alloc>::intersectParallel(const AVLTree& other, unsigned threads) {
+    if (&other == this) {
+        return;
+    }
+    int height = 0;
+    BinarySearchTree<Key, Value, Compare, Alloc>::root_ = intersectNodesParallel(
+        root(), subtreeHeight(root()), other.root(), height, this->threadCount(threads));
+}
 
-    return std::max(leftHeight, rightHeight) + 1;
+/*
+ * Runs rightWork(helper) on a new thread and leftWork() on this one,
+ * where helper is an empty AVLTree whose allocator is shared with this
+ * one, and returns when both are done. The nodes the helper destroyed
+ * are then taken off this tree's count, the blocks it freed go to this
+ * tree's allocator for reuse, and its operation counts are added. An
+ * exception from either side is rethrown here once both have finished.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+template<typename RightWork, typename LeftWork>
+void AVLTree<Key, Value, Compare, Alloc>::forkJoin(RightWork rightWork, LeftWork leftWork) {
+    AVLTree helper(this->comp_);
+    helper.alloc_.share(this->alloc_);
+    std::exception_ptr rightError;
+    std::thread worker([&]() {
+        try {
+            rightWork(helper);
+        } catch (...) {
+            rightError = std::current_exception();
+        }
+    });
+    std::exception_ptr leftError;
+    try {
+        leftWork();
+    } catch (...) {
+        leftError = std::current_exception();
+    }
+    worker.join();
+    // the helper's count went down by the nodes it destroyed
+    this->nodeCount_ += helper.nodeCount_;
+    helper.nodeCount_ = 0;
+    this->alloc_.adopt(helper.alloc_);
+#ifdef BST_STATS
+    this->counter_.merge(helper.counter_);
+#endif
+    helper.BinarySearchTree<Key, Value, Compare, Alloc>::root_ = nullptr;
+    if (leftError) {
+        std::rethrow_exception(leftError);
+    }
+    if (rightError) {
+        std::rethrow_exception(rightError);
+    }
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+AVLNode<Key, Value>* AVLTree<Key, Value, Compare, Alloc>::uniteNodesParallel(
+    AVLNode<Key, Value>* a, int aHeight, AVLNode<Key, Value>* b, int bHeight, int& height, unsigned threads) {
+    if (threads <= 1 || a == nullptr || b == nullptr || std::min(aHeight, bHeight) < PARALLEL_MIN_HEIGHT) {
+        return uniteNodes(a, aHeight, b, bHeight, height);
+    }
+    AVLNode<Key, Value>* bLeft;
+    AVLNode<Key, Value>* bMid;
+    AVLNode<Key, Value>* bRight;
+    int bLeftHeight, bRightHeight;
+    splitNodes(b, bHeight, a->getKey(), bLeft, bLeftHeight, bMid, bRight, bRightHeight);
+    if (bMid != nullptr) {
+        this->destroyNode(bMid);
+    }
+    AVLNode<Key, Value>* aLeft = a->getLeft();
+    AVLNode<Key, Value>* aRight = a->getRight();
+    int aLeftHeight = aHeight - ((a->getBalance() > 0) ? 2 : 1);
+    int aRightHeight = aHeight - ((a->getBalance() < 0) ? 2 : 1);
+    if (aLeft != nullptr) {
+        aLeft->setParent(nullptr);
+    }
+    if (aRight != nullptr) {
+        aRight->setParent(nullptr);
+    }
+    unsigned rightThreads = threads / 2;
+    AVLNode<Key, Value>* right = nullptr;
+    int rightHeight = 0;
+    AVLNode<Key, Value>* left = nullptr;
+    int leftHeight = 0;
+    forkJoin([&](AVLTree& helper) {
+        right = helper.uniteNodesParallel(aRight, aRightHeight, bRight, bRightHeight, rightHeight, rightThreads);
+    }, [&]() {
+        left = uniteNodesParallel(aLeft, aLeftHeight, bLeft, bLeftHeight, leftHeight, threads - rightThreads);
+    });
+    return joinNodes(left, leftHeight, a, right, rightHeight, height);
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+AVLNode<Key, Value>* AVLTree<Key, Value, Compare, Alloc>::intersectNodesParallel(
+    AVLNode<Key, Value>* a, int aHeight, AVLNode<Key, Value>* b, int& height, unsigned threads) {
+    if (threads <= 1 || a == nullptr || b == nullptr || aHeight < PARALLEL_MIN_HEIGHT) {
+        return intersectNodes(a, aHeight, b, height);
+    }
+    AVLNode<Key, Value>* aLeft;
+    AVLNode<Key, Value>* aMid;
+    AVLNode<Key, Value>* aRight;
+    int aLeftHeight, aRightHeight;
+    splitNodes(a, aHeight, b->getKey(), aLeft, aLeftHeight, aMid, aRight, aRightHeight);
+    unsigned rightThreads = threads / 2;
+    AVLNode<Key, Value>* right = nullptr;
+    int rightHeight = 0;
+    AVLNode<Key, Value>* left = nullptr;
+    int leftHeight = 0;
+    forkJoin([&](AVLTree& helper) {
+        right = helper.intersectNodesParallel(aRight, aRightHeight, b->getRight(), rightHeight, rightThreads);
+    }, [&]() {
+        left = intersectNodesParallel(aLeft, aLeftHeight, b->getLeft(), leftHeight, threads - rightThreads);
+    });
+    if (aMid != nullptr) {
+        return joinNodes(left, leftHeight, aMid, right, rightHeight, height);
+    }
+    return concatNodes(left, leftHeight, right, rightHeight, height);
 }
 
 
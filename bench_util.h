@@ -0,0 +1,62 @@
+#ifndef BENCH_UTIL_H
+#define BENCH_UTIL_H
+
+// Helpers shared by bst-bench and bst-microbench, so the two measure
+// time and draw skewed keys the same way.
+
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <random>
+
+typedef std::chrono::steady_clock Clock;
+
+// Returns nanoseconds per operation between start and now
+inline double nsPerOp(Clock::time_point start, std::size_t ops)
+{
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    return ns / (double)(ops == 0 ? 1 : ops);
+}
+
+// Zipf-distributed ranks in [0, n), rank 0 the most frequent; YCSB's
+// generator, after Gray et al., "Quickly generating billion-record
+// synthetic databases"
+class Zipf
+{
+public:
+    Zipf(std::size_t n, double theta) :
+        n_(n),
+        theta_(theta),
+        zetan_(0)
+    {
+        for(std::size_t i = 1; i <= n; ++i) {
+            zetan_ += 1.0 / std::pow((double)i, theta);
+        }
+        double zeta2 = 1.0 + 1.0 / std::pow(2.0, theta);
+        alpha_ = 1.0 / (1.0 - theta);
+        eta_ = (1.0 - std::pow(2.0 / (double)n, 1.0 - theta)) / (1.0 - zeta2 / zetan_);
+    }
+
+    std::size_t operator()(std::mt19937_64& rng)
+    {
+        double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+        double uz = u * zetan_;
+        if(uz < 1.0) {
+            return 0;
+        }
+        if(uz < 1.0 + std::pow(0.5, theta_)) {
+            return 1;
+        }
+        std::size_t rank = (std::size_t)((double)n_ * std::pow(eta_ * u - eta_ + 1.0, alpha_));
+        return (rank < n_) ? rank : n_ - 1;
+    }
+
+private:
+    std::size_t n_;
+    double theta_;
+    double zetan_;
+    double alpha_;
+    double eta_;
+};
+
+#endif
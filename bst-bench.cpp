@@ -0,0 +1,737 @@
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <fstream>
+#include <string>
+#include "bst.h"
+#include "avlbst.h"
+#include "rbbst.h"
+#include "splaybst.h"
+#include "treapbst.h"
+#include "compact_avlbst.h"
+#include "concurrent_avlbst.h"
+#include "persistent_avlbst.h"
+#include "btree.h"
+#include "bench_util.h"
+
+using namespace std;
+
+void benchAVL(size_t n, mt19937_64& rng)
+{
+    vector<uint64_t> keys(n);
+    for(size_t i = 0; i < n; ++i) {
+        keys[i] = i;
+    }
+    shuffle(keys.begin(), keys.end(), rng);
+
+    AVLTree<uint64_t, uint64_t> tree;
+    Clock::time_point start = Clock::now();
+    for(size_t i = 0; i < n; ++i) {
+        tree.insert(make_pair(keys[i], keys[i]));
+    }
+    double insertNs = nsPerOp(start, n);
+
+    shuffle(keys.begin(), keys.end(), rng);
+    uint64_t sum = 0;
+    start = Clock::now();
+    for(size_t i = 0; i < n; ++i) {
+        sum += tree.find(keys[i])->second;
+    }
+    double findNs = nsPerOp(start, n);
+
+    start = Clock::now();
+    for(AVLTree<uint64_t, uint64_t>::iterator it = tree.begin(); it != tree.end(); ++it) {
+        sum += it->second;
+    }
+    double iterNs = nsPerOp(start, n);
+
+    start = Clock::now();
+    tree.forEach([&sum](pair<const uint64_t, uint64_t>& item) { sum += item.second; });
+    double forEachNs = nsPerOp(start, n);
+
+    shuffle(keys.begin(), keys.end(), rng);
+    start = Clock::now();
+    for(size_t i = 0; i < n; ++i) {
+        tree.remove(keys[i]);
+    }
+    double removeNs = nsPerOp(start, n);
+
+    cout << "AVLTree n=" << n
+         << " insert=" << insertNs << "ns"
+         << " find=" << findNs << "ns"
+         << " iterate=" << iterNs << "ns"
+         << " forEach=" << forEachNs << "ns"
+         << " remove=" << removeNs << "ns"
+         << " (checksum " << sum << ")" << endl;
+}
+
+void benchBuild(size_t n)
+{
+    vector<pair<uint64_t, uint64_t> > items(n);
+    for(size_t i = 0; i < n; ++i) {
+        items[i] = make_pair((uint64_t)i, (uint64_t)i);
+    }
+
+    Clock::time_point start = Clock::now();
+    AVLTree<uint64_t, uint64_t> looped;
+    for(size_t i = 0; i < n; ++i) {
+        looped.insert(items[i]);
+    }
+    double loopNs = nsPerOp(start, n);
+
+    start = Clock::now();
+    AVLTree<uint64_t, uint64_t> built(items.begin(), items.end());
+    double buildNs = nsPerOp(start, n);
+
+    cout << "AVLTree sorted load n=" << n
+         << " insert loop=" << loopNs << "ns"
+         << " range constructor=" << buildNs << "ns" << endl;
+}
+
+void benchBatch(size_t n, size_t batchSize, mt19937_64& rng)
+{
+    vector<pair<uint64_t, uint64_t> > items(n);
+    for(size_t i = 0; i < n; ++i) {
+        items[i] = make_pair((uint64_t)i * 2, (uint64_t)i);
+    }
+    vector<pair<uint64_t, uint64_t> > batch(batchSize);
+    vector<uint64_t> keys(batchSize);
+    for(size_t i = 0; i < batchSize; ++i) {
+        batch[i] = make_pair(rng() % (2 * n), (uint64_t)i);
+        keys[i] = batch[i].first;
+    }
+
+    AVLTree<uint64_t, uint64_t> looped(items.begin(), items.end());
+    Clock::time_point start = Clock::now();
+    for(size_t i = 0; i < batchSize; ++i) {
+        looped.insert(batch[i]);
+    }
+    double loopInsertNs = nsPerOp(start, batchSize);
+    start = Clock::now();
+    for(size_t i = 0; i < batchSize; ++i) {
+        looped.remove(keys[i]);
+    }
+    double loopRemoveNs = nsPerOp(start, batchSize);
+
+    AVLTree<uint64_t, uint64_t> batched(items.begin(), items.end());
+    start = Clock::now();
+    batched.insertBatch(batch.begin(), batch.end());
+    double batchInsertNs = nsPerOp(start, batchSize);
+    start = Clock::now();
+    batched.removeBatch(keys.begin(), keys.end());
+    double batchRemoveNs = nsPerOp(start, batchSize);
+
+    cout << "AVLTree n=" << n << " batch=" << batchSize
+         << " insert loop=" << loopInsertNs << "ns"
+         << " insertBatch=" << batchInsertNs << "ns"
+         << " remove loop=" << loopRemoveNs << "ns"
+         << " removeBatch=" << batchRemoveNs << "ns" << endl;
+}
+
+// shuffled finds on the live tree against its frozen snapshot
+void benchFrozen(size_t n, mt19937_64& rng)
+{
+    vector<pair<uint64_t, uint64_t> > items(n);
+    for(size_t i = 0; i < n; ++i) {
+        items[i] = make_pair((uint64_t)i * 7, (uint64_t)i);
+    }
+    AVLTree<uint64_t, uint64_t> tree(items.begin(), items.end());
+    vector<uint64_t> keys(n);
+    for(size_t i = 0; i < n; ++i) {
+        keys[i] = rng() % (7 * n);
+    }
+
+    uint64_t sum = 0;
+    Clock::time_point start = Clock::now();
+    for(size_t i = 0; i < n; ++i) {
+        sum += tree.lower_bound(keys[i]) != tree.end();
+    }
+    double liveNs = nsPerOp(start, n);
+
+    start = Clock::now();
+    FrozenTree<uint64_t, uint64_t> frozen = tree.freeze();
+    double freezeNs = nsPerOp(start, n);
+
+    start = Clock::now();
+    for(size_t i = 0; i < n; ++i) {
+        sum += frozen.lower_bound(keys[i]) != frozen.end();
+    }
+    double frozenNs = nsPerOp(start, n);
+
+    cout << "AVLTree n=" << n
+         << " lower_bound=" << liveNs << "ns"
+         << " freeze=" << freezeNs << "ns"
+         << " frozen lower_bound=" << frozenNs << "ns"
+         << " (checksum " << sum << ")" << endl;
+}
+
+// Batches of random keys probed against a tree of n keys: find() per
+// key on the live AVLTree, and lowerBoundMany()/findMany() on a frozen
+// copy (vectorized for these uint64_t keys where the CPU allows)
+void benchFrozenBatch(size_t n, size_t batch, mt19937_64& rng)
+{
+    vector<pair<uint64_t, uint64_t> > items(n);
+    for(size_t i = 0; i < n; ++i) {
+        items[i] = make_pair((uint64_t)i * 7, (uint64_t)i);
+    }
+    AVLTree<uint64_t, uint64_t> tree(items.begin(), items.end());
+    FrozenTree<uint64_t, uint64_t> frozen = tree.freeze();
+    size_t probes = min(n, (size_t)1000000) / batch * batch;
+    vector<uint64_t> keys(probes);
+    for(size_t i = 0; i < probes; ++i) {
+        keys[i] = rng() % (7 * n);
+    }
+
+    uint64_t sum = 0;
+    Clock::time_point start = Clock::now();
+    for(size_t i = 0; i < probes; ++i) {
+        sum += tree.find(keys[i]) != tree.end();
+    }
+    double findNs = nsPerOp(start, probes);
+
+    vector<FrozenTree<uint64_t, uint64_t>::iterator> found(batch);
+    start = Clock::now();
+    for(size_t i = 0; i < probes; i += batch) {
+        frozen.lowerBoundMany(keys.begin() + i, keys.begin() + i + batch, found.begin());
+        sum += found[0] != frozen.end();
+    }
+    double lowerNs = nsPerOp(start, probes);
+
+    start = Clock::now();
+    for(size_t i = 0; i < probes; i += batch) {
+        frozen.findMany(keys.begin() + i, keys.begin() + i + batch, found.begin());
+        sum += found[0] != frozen.end();
+    }
+    double manyNs = nsPerOp(start, probes);
+
+    cout << "AVLTree n=" << n << " batch=" << batch
+         << " find=" << findNs << "ns"
+         << " frozen lowerBoundMany=" << lowerNs << "ns"
+         << " frozen findMany=" << manyNs << "ns"
+         << " (checksum " << sum << ")" << endl;
+}
+
+// Runs lookup(thread, i) for i in [0, perThread) on each of threads
+// threads and returns the total lookups per microsecond
+template<typename Lookup>
+double runThreads(size_t threads, size_t perThread, Lookup lookup)
+{
+    vector<thread> workers;
+    Clock::time_point start = Clock::now();
+    for(size_t t = 0; t < threads; ++t) {
+        workers.push_back(thread([t, perThread, &lookup]() {
+            for(size_t i = 0; i < perThread; ++i) {
+                lookup(t, i);
+            }
+        }));
+    }
+    for(size_t t = 0; t < workers.size(); ++t) {
+        workers[t].join();
+    }
+    return 1000.0 / nsPerOp(start, threads * perThread);
+}
+
+// Read throughput of ConcurrentAVLTree against an AVLTree behind one
+// std::mutex, for 1, 2, 4, ... threads up to the core count, then the
+// same at the core count with one thread writing continuously
+void benchConcurrent(size_t n, mt19937_64& rng)
+{
+    const size_t perThread = 1000000;
+    vector<pair<uint64_t, uint64_t> > items(n);
+    for(size_t i = 0; i < n; ++i) {
+        items[i] = make_pair((uint64_t)i, (uint64_t)i);
+    }
+    vector<uint64_t> keys(perThread);
+    for(size_t i = 0; i < perThread; ++i) {
+        keys[i] = rng() % n;
+    }
+    ConcurrentAVLTree<uint64_t, uint64_t> shared;
+    AVLTree<uint64_t, uint64_t> locked(items.begin(), items.end());
+    mutex lockedMutex;
+    for(size_t i = 0; i < n; ++i) {
+        shared.insert(items[i]);
+    }
+
+    size_t cores = thread::hardware_concurrency();
+    if(cores == 0) {
+        cores = 1;
+    }
+    atomic<uint64_t> sum(0);
+    auto concurrentFind = [&](size_t t, size_t i) {
+        uint64_t value;
+        if(shared.find(keys[(i + t * 7919) % perThread], value)) {
+            sum.fetch_add(value, memory_order_relaxed);
+        }
+    };
+    auto mutexFind = [&](size_t t, size_t i) {
+        lock_guard<mutex> guard(lockedMutex);
+        sum.fetch_add(locked.find(keys[(i + t * 7919) % perThread])->second, memory_order_relaxed);
+    };
+    for(size_t threads = 1; ; threads *= 2) {
+        if(threads > cores) {
+            threads = cores;
+        }
+        double concurrentRate = runThreads(threads, perThread, concurrentFind);
+        double mutexRate = runThreads(threads, perThread, mutexFind);
+        cout << "ConcurrentAVLTree n=" << n << " threads=" << threads
+             << " find=" << concurrentRate << "M/s"
+             << " (mutex AVLTree " << mutexRate << "M/s)" << endl;
+        if(threads == cores) {
+            break;
+        }
+    }
+
+    atomic<bool> done(false);
+    thread writer([&]() {
+        for(uint64_t i = 0; !done.load(); ++i) {
+            uint64_t key = n + (i % 1024);
+            shared.insert(make_pair(key, key));
+            shared.remove(key);
+        }
+    });
+    double mixedRate = runThreads(cores, perThread, concurrentFind);
+    done.store(true);
+    writer.join();
+    cout << "ConcurrentAVLTree n=" << n << " threads=" << cores
+         << " find with a writer=" << mixedRate << "M/s"
+         << " (checksum " << sum.load() << ")" << endl;
+}
+
+// Shuffled inserts into a PersistentAVLTree with no snapshots (all in
+// place) and with a snapshot held across every 100 inserts (paths are
+// copied), against AVLTree
+void benchPersistent(size_t n, mt19937_64& rng)
+{
+    vector<uint64_t> keys(n);
+    for(size_t i = 0; i < n; ++i) {
+        keys[i] = i;
+    }
+    shuffle(keys.begin(), keys.end(), rng);
+
+    Clock::time_point start = Clock::now();
+    AVLTree<uint64_t, uint64_t> avl;
+    for(size_t i = 0; i < n; ++i) {
+        avl.insert(make_pair(keys[i], keys[i]));
+    }
+    double avlNs = nsPerOp(start, n);
+
+    start = Clock::now();
+    PersistentAVLTree<uint64_t, uint64_t> unshared;
+    for(size_t i = 0; i < n; ++i) {
+        unshared.insert(make_pair(keys[i], keys[i]));
+    }
+    double unsharedNs = nsPerOp(start, n);
+
+    start = Clock::now();
+    PersistentAVLTree<uint64_t, uint64_t> versioned;
+    PersistentAVLTree<uint64_t, uint64_t> held;
+    for(size_t i = 0; i < n; ++i) {
+        if(i % 100 == 0) {
+            held = versioned.snapshot();
+        }
+        versioned.insert(make_pair(keys[i], keys[i]));
+    }
+    double versionedNs = nsPerOp(start, n);
+
+    start = Clock::now();
+    for(size_t i = 0; i < n; ++i) {
+        held = versioned.snapshot();
+    }
+    double snapshotNs = nsPerOp(start, n);
+
+    cout << "PersistentAVLTree n=" << n
+         << " insert=" << unsharedNs << "ns"
+         << " insert with snapshots=" << versionedNs << "ns"
+         << " snapshot=" << snapshotNs << "ns"
+         << " (AVLTree insert " << avlNs << "ns, sizes "
+         << unshared.size() + held.size() << ")" << endl;
+}
+
+// Moving the upper half of a tree out and back with split/join, against
+// remove/insert per key, and unite against inserting the other tree's
+// items one by one
+void benchSplitJoin(size_t n, mt19937_64& rng)
+{
+    vector<pair<uint64_t, uint64_t> > items(n);
+    for(size_t i = 0; i < n; ++i) {
+        items[i] = make_pair((uint64_t)i, (uint64_t)i);
+    }
+    AVLTree<uint64_t, uint64_t> tree(items.begin(), items.end());
+    AVLTree<uint64_t, uint64_t> upper;
+    Clock::time_point start = Clock::now();
+    tree.split(n / 2, upper);
+    tree.join(upper);
+    double splitJoinNs = nsPerOp(start, 1);
+
+    start = Clock::now();
+    for(size_t i = n / 2; i < n; ++i) {
+        tree.remove(i);
+        upper.insert(items[i]);
+    }
+    for(size_t i = n / 2; i < n; ++i) {
+        tree.insert(items[i]);
+    }
+    upper.clear();
+    double perKeyNs = nsPerOp(start, 1);
+
+    vector<pair<uint64_t, uint64_t> > others(n / 10);
+    for(size_t i = 0; i < others.size(); ++i) {
+        others[i] = make_pair(rng() % (2 * n), (uint64_t)i);
+    }
+    AVLTree<uint64_t, uint64_t> looped(items.begin(), items.end());
+    start = Clock::now();
+    for(size_t i = 0; i < others.size(); ++i) {
+        looped.insert(others[i]);
+    }
+    double loopNs = nsPerOp(start, 1);
+    AVLTree<uint64_t, uint64_t> united(items.begin(), items.end());
+    AVLTree<uint64_t, uint64_t> other(others.begin(), others.end());
+    start = Clock::now();
+    united.unite(other);
+    double uniteNs = nsPerOp(start, 1);
+
+    cout << "AVLTree n=" << n
+         << " split+join half=" << splitJoinNs / 1000 << "us"
+         << " (per key " << perKeyNs / 1000 << "us)"
+         << " unite n/10=" << uniteNs / 1000 << "us"
+         << " (insert loop " << loopNs / 1000 << "us, sizes "
+         << united.size() << " " << looped.size() << ")" << endl;
+}
+
+// Sorted bulk build and unite of two same-sized trees on 1, 2, 4, ...
+// threads up to the core count
+void benchParallel(size_t n, mt19937_64& rng)
+{
+    vector<pair<uint64_t, uint64_t> > items(n);
+    for(size_t i = 0; i < n; ++i) {
+        items[i] = make_pair((uint64_t)i * 2, (uint64_t)i);
+    }
+    vector<pair<uint64_t, uint64_t> > others(n);
+    for(size_t i = 0; i < n; ++i) {
+        others[i] = make_pair(rng() % (4 * n), (uint64_t)i);
+    }
+    size_t cores = thread::hardware_concurrency();
+    if(cores == 0) {
+        cores = 1;
+    }
+    for(size_t threads = 1; ; threads *= 2) {
+        if(threads > cores) {
+            threads = cores;
+        }
+        AVLTree<uint64_t, uint64_t> tree;
+        Clock::time_point start = Clock::now();
+        tree.assignParallel(items.begin(), items.end(), (unsigned)threads);
+        double buildNs = nsPerOp(start, n);
+
+        AVLTree<uint64_t, uint64_t> other(others.begin(), others.end());
+        start = Clock::now();
+        tree.uniteParallel(other, (unsigned)threads);
+        double uniteNs = nsPerOp(start, n);
+
+        cout << "AVLTree n=" << n << " threads=" << threads
+             << " assignParallel=" << buildNs << "ns"
+             << " uniteParallel=" << uniteNs << "ns"
+             << " (size " << tree.size() << ")" << endl;
+        if(threads == cores) {
+            break;
+        }
+    }
+}
+
+// insert/find/iterate/remove on shuffled keys for any tree with the
+// BinarySearchTree interface
+template<typename Tree>
+void benchTree(const char* name, size_t n, mt19937_64& rng)
+{
+    vector<uint64_t> keys(n);
+    for(size_t i = 0; i < n; ++i) {
+        keys[i] = i * 7;
+    }
+    shuffle(keys.begin(), keys.end(), rng);
+
+    Tree tree;
+    Clock::time_point start = Clock::now();
+    for(size_t i = 0; i < n; ++i) {
+        tree.insert(make_pair(keys[i], keys[i]));
+    }
+    double insertNs = nsPerOp(start, n);
+
+    shuffle(keys.begin(), keys.end(), rng);
+    uint64_t sum = 0;
+    start = Clock::now();
+    for(size_t i = 0; i < n; ++i) {
+        sum += (*tree.find(keys[i])).second;
+    }
+    double findNs = nsPerOp(start, n);
+
+    start = Clock::now();
+    for(typename Tree::iterator it = tree.begin(); it != tree.end(); ++it) {
+        sum += (*it).second;
+    }
+    double iterNs = nsPerOp(start, n);
+
+    shuffle(keys.begin(), keys.end(), rng);
+    start = Clock::now();
+    for(size_t i = 0; i < n; ++i) {
+        tree.remove(keys[i]);
+    }
+    double removeNs = nsPerOp(start, n);
+
+    cout << name << " n=" << n
+         << " insert=" << insertNs << "ns"
+         << " find=" << findNs << "ns"
+         << " iterate=" << iterNs << "ns"
+         << " remove=" << removeNs << "ns"
+         << " (checksum " << sum << ")" << endl;
+}
+
+// Random lookups on a tree of n shuffled keys, one find() per key
+// against findMany() over batches of 1024 keys
+void benchFindMany(size_t n, mt19937_64& rng)
+{
+    vector<uint64_t> keys(n);
+    for(size_t i = 0; i < n; ++i) {
+        keys[i] = i * 7;
+    }
+    shuffle(keys.begin(), keys.end(), rng);
+    AVLTree<uint64_t, uint64_t> tree;
+    for(size_t i = 0; i < n; ++i) {
+        tree.insert(make_pair(keys[i], keys[i]));
+    }
+    shuffle(keys.begin(), keys.end(), rng);
+
+    uint64_t sum = 0;
+    Clock::time_point start = Clock::now();
+    for(size_t i = 0; i < n; ++i) {
+        sum += tree.find(keys[i])->second;
+    }
+    double findNs = nsPerOp(start, n);
+
+    const size_t batch = 1024;
+    vector<AVLTree<uint64_t, uint64_t>::iterator> found(batch);
+    start = Clock::now();
+    for(size_t i = 0; i < n; i += batch) {
+        size_t end = min(n, i + batch);
+        tree.findMany(keys.begin() + i, keys.begin() + end, found.begin());
+        for(size_t j = 0; j < end - i; ++j) {
+            sum += found[j]->second;
+        }
+    }
+    double manyNs = nsPerOp(start, n);
+
+    cout << "AVLTree n=" << n
+         << " find=" << findNs << "ns"
+         << " findMany=" << manyNs << "ns"
+         << " (checksum " << sum << ")" << endl;
+}
+
+// Resident set size of this process in KB, from /proc (0 where there is none)
+long residentKB()
+{
+    ifstream status("/proc/self/status");
+    string line;
+    while(getline(status, line)) {
+        if(line.compare(0, 6, "VmRSS:") == 0) {
+            return strtol(line.c_str() + 6, NULL, 10);
+        }
+    }
+    return 0;
+}
+
+// Memory per key of a tree of n random keys, as growth in resident set
+// size while it is built
+template<typename Tree>
+void benchMemory(const char* name, size_t n, mt19937_64& rng)
+{
+    long before = residentKB();
+    Tree tree;
+    for(size_t i = 0; i < n; ++i) {
+        tree.insert(make_pair((uint64_t)rng(), (uint64_t)i));
+    }
+    long after = residentKB();
+    cout << name << " n=" << n
+         << " rss=" << (after - before) / 1024 << "MB"
+         << " bytes/key=" << (after - before) * 1024.0 / (double)n << endl;
+}
+
+// Repeated intersectParallel/insert cycles on a tree of n keys: the
+// nodes freed on the worker threads must be reused by the inserts, so
+// resident memory should not grow from one cycle to the next
+void benchIntersectReuse(size_t n)
+{
+    vector<pair<uint64_t, uint64_t> > evens;
+    for(size_t i = 0; i < n; i += 2) {
+        evens.push_back(make_pair((uint64_t)i, (uint64_t)i));
+    }
+    AVLTree<uint64_t, uint64_t> keep(evens.begin(), evens.end());
+    AVLTree<uint64_t, uint64_t> tree;
+    for(size_t i = 0; i < n; ++i) {
+        tree.insert(make_pair((uint64_t)i, (uint64_t)i));
+    }
+    const int cycles = 10;
+    long before = 0;
+    Clock::time_point start = Clock::now();
+    for(int c = 0; c < cycles; ++c) {
+        tree.intersectParallel(keep, 4);
+        for(size_t i = 1; i < n; i += 2) {
+            tree.insert(make_pair((uint64_t)i, (uint64_t)i));
+        }
+        if(c == 0) {
+            before = residentKB();
+        }
+    }
+    double cycleNs = nsPerOp(start, cycles * n);
+    long growth = residentKB() - before;
+    cout << "AVLTree n=" << n
+         << " intersectParallel+insert cycle=" << cycleNs << "ns/key"
+         << " rss growth over " << cycles - 1 << " cycles=" << growth << "KB"
+         << (growth > (long)(n / 1024) ? " (GROWING)" : "") << endl;
+}
+
+// A sliding window of n keys, as in a TTL index keyed by expiry time:
+// each step inserts the newest key and removes the oldest, so every
+// update lands at one end of the tree
+template<typename Tree>
+void benchExpiry(const char* name, size_t n)
+{
+    Tree tree;
+    for(size_t i = 0; i < n; ++i) {
+        tree.insert(make_pair((uint64_t)i, (uint64_t)i));
+    }
+    size_t steps = 4 * n;
+    Clock::time_point start = Clock::now();
+    for(size_t i = 0; i < steps; ++i) {
+        tree.insert(make_pair((uint64_t)(n + i), (uint64_t)i));
+        tree.remove((uint64_t)i);
+    }
+    double stepNs = nsPerOp(start, steps);
+    cout << name << " n=" << n
+         << " expire+insert=" << stepNs << "ns"
+         << " (size " << tree.size() << ")" << endl;
+}
+
+// Lookups under skewed access: a Zipfian stream (exponent 0.99) over a
+// tree of n shuffled keys, then a stream of only the 256 hottest keys,
+// then a uniform stream, which shows what self-adjustment costs when
+// there is no skew to exploit. The hottest ranks map to keys spread over
+// the whole key range.
+template<typename Tree>
+void benchSkewed(const char* name, size_t n, mt19937_64& rng)
+{
+    vector<uint64_t> keys(n);
+    for(size_t i = 0; i < n; ++i) {
+        keys[i] = i * 7;
+    }
+    shuffle(keys.begin(), keys.end(), rng);
+    Tree tree;
+    for(size_t i = 0; i < n; ++i) {
+        tree.insert(make_pair(keys[i], keys[i]));
+    }
+
+    Zipf zipf(n, 0.99);
+    vector<uint64_t> zipfKeys(n);
+    vector<uint64_t> hotKeys(n);
+    vector<uint64_t> uniformKeys(n);
+    for(size_t i = 0; i < n; ++i) {
+        zipfKeys[i] = keys[zipf(rng)];
+        hotKeys[i] = keys[rng() % 256];
+        uniformKeys[i] = keys[rng() % n];
+    }
+
+    uint64_t sum = 0;
+    Clock::time_point start = Clock::now();
+    for(size_t i = 0; i < n; ++i) {
+        sum += tree.find(zipfKeys[i])->second;
+    }
+    double zipfNs = nsPerOp(start, n);
+
+    start = Clock::now();
+    for(size_t i = 0; i < n; ++i) {
+        sum += tree.find(hotKeys[i])->second;
+    }
+    double hotNs = nsPerOp(start, n);
+
+    start = Clock::now();
+    for(size_t i = 0; i < n; ++i) {
+        sum += tree.find(uniformKeys[i])->second;
+    }
+    double uniformNs = nsPerOp(start, n);
+
+    cout << name << " n=" << n
+         << " zipfian find=" << zipfNs << "ns"
+         << " hot find=" << hotNs << "ns"
+         << " uniform find=" << uniformNs << "ns"
+         << " (checksum " << sum << ")" << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    // largest tree size to run, e.g. ./bst-bench 10000000
+    size_t maxN = 1000000;
+    if(argc > 1) {
+        maxN = strtoull(argv[1], NULL, 10);
+    }
+    mt19937_64 rng(104);
+    // first, while the heap has no freed memory a tree could reuse
+    benchMemory<AVLTree<uint64_t, uint64_t> >("AVLTree", maxN, rng);
+    benchMemory<CompactAVLTree<uint64_t, uint64_t> >("CompactAVLTree", maxN, rng);
+    for(size_t n = 1000; n <= maxN; n *= 10) {
+        benchAVL(n, rng);
+    }
+    for(size_t n = 1000; n <= maxN; n *= 10) {
+        benchBuild(n);
+    }
+    for(size_t n = 1000000; n <= maxN; n *= 10) {
+        benchTree<AVLTree<uint64_t, uint64_t> >("AVLTree", n, rng);
+        benchTree<RBTree<uint64_t, uint64_t> >("RBTree", n, rng);
+        benchTree<CompactAVLTree<uint64_t, uint64_t> >("CompactAVLTree", n, rng);
+        benchTree<BTree<uint64_t, uint64_t, 16> >("BTree<16>", n, rng);
+        benchTree<BTree<uint64_t, uint64_t, 32> >("BTree<32>", n, rng);
+        benchTree<BTree<uint64_t, uint64_t, 64> >("BTree<64>", n, rng);
+    }
+    for(size_t n = 1000000; n <= maxN; n *= 10) {
+        benchFindMany(n, rng);
+    }
+    for(size_t n = 1000; n <= maxN; n *= 10) {
+        benchExpiry<AVLTree<uint64_t, uint64_t> >("AVLTree", n);
+        benchExpiry<RBTree<uint64_t, uint64_t> >("RBTree", n);
+    }
+    for(size_t n = 1000000; n <= maxN; n *= 10) {
+        benchSkewed<AVLTree<uint64_t, uint64_t> >("AVLTree", n, rng);
+        benchSkewed<SplayTree<uint64_t, uint64_t> >("SplayTree", n, rng);
+        benchSkewed<Treap<uint64_t, uint64_t> >("Treap", n, rng);
+    }
+    for(size_t n = 1000; n <= maxN; n *= 10) {
+        benchFrozen(n, rng);
+    }
+    for(size_t n = 1000000; n <= maxN; n *= 10) {
+        benchFrozenBatch(n, 64, rng);
+        benchFrozenBatch(n, 1024, rng);
+    }
+    for(size_t n = 1000000; n <= maxN; n *= 10) {
+        benchConcurrent(n, rng);
+    }
+    for(size_t n = 1000; n <= maxN; n *= 10) {
+        benchPersistent(n, rng);
+    }
+    for(size_t n = 1000; n <= maxN; n *= 10) {
+        benchSplitJoin(n, rng);
+    }
+    for(size_t n = 1000000; n <= maxN; n *= 10) {
+        benchParallel(n, rng);
+        benchIntersectReuse(n);
+    }
+    for(size_t n = 100000; n <= maxN; n *= 10) {
+        benchBatch(n, 10000, rng);
+        benchBatch(n, 100000, rng);
+    }
+    return 0;
+}
@@ -0,0 +1,303 @@
+// Randomized checks of AVLTree's split/join and set operations, serial
+// and parallel, against std::map. After every operation each tree must
+// hold the same items as its model, in both directions of iteration,
+// and every balance factor, parent link and subtree size must match the
+// shape of the tree. Prints the first mismatch and exits with status 1.
+//
+// Usage: bst-check [rounds] [seed]
+
+#include <iostream>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include "avlbst.h"
+
+using namespace std;
+
+typedef map<int, int> Model;
+
+// An AVLTree that can check its own links
+class CheckedTree : public AVLTree<int, int>
+{
+public:
+    bool linksValid() const
+    {
+        int height;
+        return checkSubtree(root(), nullptr, height);
+    }
+
+private:
+    // Sets height to the height of n's subtree and returns false if a
+    // parent link, balance factor or subtree size in it is wrong
+    static bool checkSubtree(const AVLNode<int, int>* n, const AVLNode<int, int>* parent, int& height)
+    {
+        if(n == nullptr) {
+            height = 0;
+            return true;
+        }
+        int leftHeight;
+        int rightHeight;
+        if(n->getParent() != parent ||
+           !checkSubtree(n->getLeft(), n, leftHeight) ||
+           !checkSubtree(n->getRight(), n, rightHeight)) {
+            return false;
+        }
+        height = 1 + max(leftHeight, rightHeight);
+#ifdef BST_SUBTREE_SIZE
+        if(n->getSize() != subtreeSize(n->getLeft()) + subtreeSize(n->getRight()) + 1) {
+            return false;
+        }
+#endif
+        return n->getBalance() == rightHeight - leftHeight;
+    }
+};
+
+void fail(const string& what)
+{
+    cout << "FAILED: " << what << endl;
+    exit(1);
+}
+
+void expectSame(CheckedTree& tree, const Model& model, const string& what)
+{
+    if(!tree.linksValid()) {
+        fail(what + ": bad parent link, balance or subtree size");
+    }
+    if(tree.size() != model.size()) {
+        fail(what + ": size " + to_string(tree.size()) + ", expected " + to_string(model.size()));
+    }
+    Model::const_iterator m = model.begin();
+    for(CheckedTree::iterator it = tree.begin(); it != tree.end(); ++it, ++m) {
+        if(m == model.end() || it->first != m->first || it->second != m->second) {
+            fail(what + ": items differ going forward");
+        }
+    }
+    Model::const_reverse_iterator rm = model.rbegin();
+    for(CheckedTree::reverse_iterator it = tree.rbegin(); it != tree.rend(); ++it, ++rm) {
+        if(rm == model.rend() || it->first != rm->first || it->second != rm->second) {
+            fail(what + ": items differ going backward");
+        }
+    }
+}
+
+// Fills tree and model with about n random keys below maxKey, either by
+// single inserts and removes, so the balances come from rebalancing, or
+// by a bulk build
+void fill(CheckedTree& tree, Model& model, size_t n, int maxKey, mt19937& rng)
+{
+    tree.clear();
+    model.clear();
+    if(rng() % 2 == 0) {
+        for(size_t i = 0; i < n; ++i) {
+            int key = (int)(rng() % maxKey);
+            int value = (int)rng();
+            tree.insert(make_pair(key, value));
+            model[key] = value;
+        }
+        for(size_t i = 0; i < n / 4; ++i) {
+            int key = (int)(rng() % maxKey);
+            tree.remove(key);
+            model.erase(key);
+        }
+    }
+    else {
+        vector<pair<int, int> > items;
+        for(size_t i = 0; i < n; ++i) {
+            items.push_back(make_pair((int)(rng() % maxKey), (int)rng()));
+        }
+        tree.assign(items.begin(), items.end());
+        for(size_t i = 0; i < items.size(); ++i) {
+            model[items[i].first] = items[i].second;
+        }
+    }
+    expectSame(tree, model, "fill");
+}
+
+// A few more updates, to make sure the result of an operation is a tree
+// the ordinary insert and remove can keep working on
+void touch(CheckedTree& tree, Model& model, int maxKey, mt19937& rng, const string& what)
+{
+    for(int i = 0; i < 20; ++i) {
+        int key = (int)(rng() % maxKey);
+        if(rng() % 2 == 0) {
+            tree.insert(make_pair(key, i));
+            model[key] = i;
+        }
+        else {
+            tree.remove(key);
+            model.erase(key);
+        }
+    }
+    expectSame(tree, model, what + " then updates");
+}
+
+void checkSplitJoin(size_t n, int maxKey, mt19937& rng)
+{
+    CheckedTree tree;
+    Model model;
+    fill(tree, model, n, maxKey, rng);
+    int key = (int)(rng() % (maxKey + 2)) - 1;
+
+    CheckedTree upper;
+    Model upperModel(model.lower_bound(key), model.end());
+    model.erase(model.lower_bound(key), model.end());
+    tree.split(key, upper);
+    expectSame(tree, model, "split below");
+    expectSame(upper, upperModel, "split at or above");
+
+    if(!model.empty() && !upperModel.empty()) {
+        CheckedTree overlap;
+        Model overlapModel;
+        overlap.insert(make_pair(upperModel.begin()->first, 0));
+        overlapModel[upperModel.begin()->first] = 0;
+        bool threw = false;
+        try {
+            upper.join(overlap);
+        }
+        catch(invalid_argument&) {
+            threw = true;
+        }
+        if(!threw) {
+            fail("join of overlapping trees did not throw");
+        }
+        expectSame(upper, upperModel, "failed join");
+        expectSame(overlap, overlapModel, "failed join argument");
+    }
+
+    model.insert(upperModel.begin(), upperModel.end());
+    if(rng() % 2 == 0) {
+        tree.join(upper);
+        expectSame(tree, model, "join above");
+        expectSame(upper, Model(), "joined tree");
+        touch(tree, model, maxKey, rng, "join above");
+    }
+    else {
+        upper.join(tree);
+        expectSame(upper, model, "join below");
+        expectSame(tree, Model(), "joined tree");
+        touch(upper, model, maxKey, rng, "join below");
+    }
+}
+
+void checkSetOperations(size_t n, size_t m, int maxKey, mt19937& rng)
+{
+    CheckedTree a;
+    CheckedTree b;
+    Model aModel;
+    Model bModel;
+
+    fill(a, aModel, n, maxKey, rng);
+    fill(b, bModel, m, maxKey, rng);
+    Model united = aModel;
+    united.insert(bModel.begin(), bModel.end());
+    a.unite(b);
+    expectSame(a, united, "unite");
+    expectSame(b, Model(), "united argument");
+    touch(a, united, maxKey, rng, "unite");
+
+    fill(a, aModel, n, maxKey, rng);
+    fill(b, bModel, m, maxKey, rng);
+    Model common;
+    for(Model::const_iterator it = aModel.begin(); it != aModel.end(); ++it) {
+        if(bModel.count(it->first) != 0) {
+            common.insert(*it);
+        }
+    }
+    a.intersect(b);
+    expectSame(a, common, "intersect");
+    expectSame(b, bModel, "intersect argument");
+    touch(a, common, maxKey, rng, "intersect");
+
+    fill(a, aModel, n, maxKey, rng);
+    Model difference;
+    for(Model::const_iterator it = aModel.begin(); it != aModel.end(); ++it) {
+        if(bModel.count(it->first) == 0) {
+            difference.insert(*it);
+        }
+    }
+    a.subtract(b);
+    expectSame(a, difference, "subtract");
+    expectSame(b, bModel, "subtract argument");
+    touch(a, difference, maxKey, rng, "subtract");
+}
+
+// The parallel build, unite and intersect on trees big enough to be cut
+// up between that many threads. The thread count is explicit so the
+// threaded paths run even on a machine with one core.
+void checkParallel(size_t n, unsigned threads, mt19937& rng)
+{
+    string what = " with " + to_string(threads) + " threads";
+    int maxKey = (int)(4 * n);
+    vector<pair<int, int> > items;
+    Model model;
+    for(size_t i = 0; i < n; ++i) {
+        int key = (int)(rng() % maxKey);
+        items.push_back(make_pair(key, (int)i));
+        model[key] = (int)i;
+    }
+    CheckedTree a;
+    a.assignParallel(items.begin(), items.end(), threads);
+    expectSame(a, model, "unsorted assignParallel" + what);
+
+    sort(items.begin(), items.end());
+    items.erase(unique(items.begin(), items.end(),
+                       [](const pair<int, int>& x, const pair<int, int>& y) { return x.first == y.first; }),
+                items.end());
+    Model sortedModel(items.begin(), items.end());
+    CheckedTree sorted;
+    sorted.assignParallel(items.begin(), items.end(), threads);
+    expectSame(sorted, sortedModel, "sorted assignParallel" + what);
+
+    CheckedTree b;
+    Model bModel;
+    fill(b, bModel, n / 2, maxKey, rng);
+    Model common;
+    for(Model::const_iterator it = sortedModel.begin(); it != sortedModel.end(); ++it) {
+        if(bModel.count(it->first) != 0) {
+            common.insert(*it);
+        }
+    }
+    sorted.intersectParallel(b, threads);
+    expectSame(sorted, common, "intersectParallel" + what);
+    expectSame(b, bModel, "intersectParallel argument" + what);
+    touch(sorted, common, maxKey, rng, "intersectParallel" + what);
+
+    model.insert(bModel.begin(), bModel.end());
+    a.uniteParallel(b, threads);
+    expectSame(a, model, "uniteParallel" + what);
+    expectSame(b, Model(), "uniteParallel argument" + what);
+    touch(a, model, maxKey, rng, "uniteParallel" + what);
+}
+
+int main(int argc, char *argv[])
+{
+    int rounds = 300;
+    unsigned seed = 1;
+    if(argc > 1) {
+        rounds = atoi(argv[1]);
+    }
+    if(argc > 2) {
+        seed = (unsigned)strtoul(argv[2], NULL, 10);
+    }
+    mt19937 rng(seed);
+
+    for(int round = 0; round < rounds; ++round) {
+        // sizes from empty up to a few thousand, with both sparse and
+        // dense keys and very unequal pairs of trees
+        size_t n = rng() % ((round % 10 == 0) ? 5000 : 200);
+        size_t m = (round % 3 == 0) ? rng() % 8 : rng() % (2 * n + 1);
+        int maxKey = 1 + (int)(rng() % (4 * n + 4));
+        checkSplitJoin(n, maxKey, rng);
+        checkSetOperations(n, m, maxKey, rng);
+    }
+    unsigned threadCounts[] = {1, 2, 3, 8};
+    for(size_t i = 0; i < sizeof(threadCounts) / sizeof(threadCounts[0]); ++i) {
+        checkParallel(1 << 16, threadCounts[i], rng);
+    }
+    cout << "bst-check: " << rounds << " rounds passed (seed " << seed << ")" << endl;
+    return 0;
+}
@@ -0,0 +1,268 @@
+// Benchmark matrix for regression tracking: insert, find, operator[],
+// full iteration, clear and remove on BinarySearchTree, AVLTree and
+// std::map, for four key orders and n = 1000, 10000, ... up to maxN.
+// Every operation is reported in ns per key as one JSON record per
+// tree/order/size:
+//
+//   ./bst-microbench [maxN] [output.json]
+//
+// maxN defaults to 1000000; pass 10000000 for the full range. Without
+// an output file the JSON goes to stdout.
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <map>
+#include <string>
+#include <algorithm>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include "bst.h"
+#include "avlbst.h"
+#include "bench_util.h"
+
+using namespace std;
+
+// A bijection on 64-bit keys (the splitmix64 finalizer), so ranks turn
+// into distinct keys spread over the whole key space
+uint64_t scramble(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// The keys one run inserts, looks up and removes, in that order
+struct Workload
+{
+    string order;
+    vector<uint64_t> inserts;
+    vector<uint64_t> lookups;
+    vector<uint64_t> removes;
+    // an unbalanced tree turns into a list under these keys
+    bool degenerate;
+};
+
+// sequential: 0, 1, 2, ... for every phase
+// random: a fresh shuffle of 0..n-1 for every phase
+// zipfian: n draws with exponent 0.99 (repeats overwrite, so the tree
+//   ends up smaller than n); lookups are the same draws reshuffled, so
+//   they all hit and hot keys dominate; removes replay the draws
+// adversarial: alternating ends, 0, n-1, 1, n-2, ..., which makes an
+//   unbalanced tree a zigzag list and makes AVLTree rebalance on most
+//   inserts
+Workload makeWorkload(const string& order, size_t n, mt19937_64& rng)
+{
+    Workload w;
+    w.order = order;
+    w.degenerate = false;
+    if(order == "sequential" || order == "random") {
+        w.inserts.resize(n);
+        for(size_t i = 0; i < n; ++i) {
+            w.inserts[i] = i;
+        }
+        w.lookups = w.inserts;
+        w.removes = w.inserts;
+        if(order == "random") {
+            shuffle(w.inserts.begin(), w.inserts.end(), rng);
+            shuffle(w.lookups.begin(), w.lookups.end(), rng);
+            shuffle(w.removes.begin(), w.removes.end(), rng);
+        }
+        else {
+            w.degenerate = true;
+        }
+    }
+    else if(order == "zipfian") {
+        Zipf zipf(n, 0.99);
+        w.inserts.resize(n);
+        for(size_t i = 0; i < n; ++i) {
+            w.inserts[i] = scramble(zipf(rng));
+        }
+        w.lookups = w.inserts;
+        shuffle(w.lookups.begin(), w.lookups.end(), rng);
+        w.removes = w.inserts;
+    }
+    else {
+        w.inserts.resize(n);
+        for(size_t i = 0; i < n; ++i) {
+            w.inserts[i] = (i % 2 == 0) ? i / 2 : n - 1 - i / 2;
+        }
+        w.lookups = w.inserts;
+        w.removes = w.inserts;
+        w.degenerate = true;
+    }
+    return w;
+}
+
+// remove() under the name each tree uses
+template<typename Tree>
+void removeKey(Tree& tree, uint64_t key)
+{
+    tree.remove(key);
+}
+
+void removeKey(map<uint64_t, uint64_t>& tree, uint64_t key)
+{
+    tree.erase(key);
+}
+
+// ns per key for each operation, the best of the repetitions
+struct Timings
+{
+    double insert;
+    double find;
+    double subscript;
+    double iterate;
+    double clear;
+    double remove;
+    size_t size;
+    uint64_t checksum;
+};
+
+// One pass over w: insert, find, operator[], iterate and clear a full
+// tree, then fill it again (untimed) and remove
+template<typename Tree>
+Timings runOnce(const Workload& w)
+{
+    Timings t;
+    uint64_t sum = 0;
+    Tree tree;
+    Clock::time_point start = Clock::now();
+    for(size_t i = 0; i < w.inserts.size(); ++i) {
+        tree.insert(make_pair(w.inserts[i], (uint64_t)i));
+    }
+    t.insert = nsPerOp(start, w.inserts.size());
+    t.size = tree.size();
+
+    start = Clock::now();
+    for(size_t i = 0; i < w.lookups.size(); ++i) {
+        sum += tree.find(w.lookups[i])->second;
+    }
+    t.find = nsPerOp(start, w.lookups.size());
+
+    start = Clock::now();
+    for(size_t i = 0; i < w.lookups.size(); ++i) {
+        sum += tree[w.lookups[i]];
+    }
+    t.subscript = nsPerOp(start, w.lookups.size());
+
+    start = Clock::now();
+    for(typename Tree::iterator it = tree.begin(); it != tree.end(); ++it) {
+        sum += it->second;
+    }
+    t.iterate = nsPerOp(start, t.size);
+
+    start = Clock::now();
+    tree.clear();
+    t.clear = nsPerOp(start, t.size);
+
+    for(size_t i = 0; i < w.inserts.size(); ++i) {
+        tree.insert(make_pair(w.inserts[i], (uint64_t)i));
+    }
+    start = Clock::now();
+    for(size_t i = 0; i < w.removes.size(); ++i) {
+        removeKey(tree, w.removes[i]);
+    }
+    t.remove = nsPerOp(start, w.removes.size());
+    sum += tree.size();
+    t.checksum = sum;
+    return t;
+}
+
+// Small sizes are repeated and the fastest pass kept, which filters
+// out timer resolution and one-off interference
+template<typename Tree>
+Timings run(const Workload& w)
+{
+    size_t reps = (w.inserts.size() <= 100000) ? 5 : 1;
+    Timings best = runOnce<Tree>(w);
+    for(size_t r = 1; r < reps; ++r) {
+        Timings t = runOnce<Tree>(w);
+        best.insert = min(best.insert, t.insert);
+        best.find = min(best.find, t.find);
+        best.subscript = min(best.subscript, t.subscript);
+        best.iterate = min(best.iterate, t.iterate);
+        best.clear = min(best.clear, t.clear);
+        best.remove = min(best.remove, t.remove);
+    }
+    return best;
+}
+
+// Writes one result record; records after the first start with a comma
+void writeRecord(ostream& out, bool& first, const string& tree, const Workload& w,
+                 const Timings* t, const char* skipped)
+{
+    out << (first ? "\n" : ",\n")
+        << "    {\"tree\": \"" << tree << "\", \"order\": \"" << w.order
+        << "\", \"n\": " << w.inserts.size();
+    if(t == NULL) {
+        out << ", \"skipped\": \"" << skipped << "\"}";
+    }
+    else {
+        out << ", \"insert\": " << t->insert
+            << ", \"find\": " << t->find
+            << ", \"operator[]\": " << t->subscript
+            << ", \"iterate\": " << t->iterate
+            << ", \"clear\": " << t->clear
+            << ", \"remove\": " << t->remove
+            << ", \"size\": " << t->size
+            << ", \"checksum\": " << t->checksum << "}";
+    }
+    out.flush();
+    first = false;
+}
+
+int main(int argc, char *argv[])
+{
+    // largest tree size to run, e.g. ./bst-microbench 10000000
+    size_t maxN = 1000000;
+    if(argc > 1) {
+        maxN = strtoull(argv[1], NULL, 10);
+    }
+    ofstream file;
+    if(argc > 2) {
+        file.open(argv[2]);
+        if(!file) {
+            cerr << "cannot write " << argv[2] << endl;
+            return 1;
+        }
+    }
+    ostream& out = (argc > 2) ? file : cout;
+    out.setf(ios::fixed);
+    out.precision(2);
+
+    // a plain BinarySearchTree fed a degenerate order costs O(n^2); past
+    // this size it would run for hours
+    const size_t maxDegenerateN = 10000;
+    const char* orders[] = { "sequential", "random", "zipfian", "adversarial" };
+#ifdef BST_SUBTREE_SIZE
+    const char* subtreeSizes = "true";
+#else
+    const char* subtreeSizes = "false";
+#endif
+    out << "{\n  \"benchmark\": \"bst-microbench\",\n  \"unit\": \"ns/op\",\n"
+        << "  \"subtreeSizes\": " << subtreeSizes << ",\n  \"results\": [";
+    bool first = true;
+    mt19937_64 rng(104);
+    for(size_t n = 1000; n <= maxN; n *= 10) {
+        for(size_t o = 0; o < sizeof(orders) / sizeof(orders[0]); ++o) {
+            Workload w = makeWorkload(orders[o], n, rng);
+            if(w.degenerate && n > maxDegenerateN) {
+                writeRecord(out, first, "BinarySearchTree", w, NULL, "quadratic: the unbalanced tree degenerates to a list");
+            }
+            else {
+                Timings bst = run<BinarySearchTree<uint64_t, uint64_t> >(w);
+                writeRecord(out, first, "BinarySearchTree", w, &bst, NULL);
+            }
+            Timings avl = run<AVLTree<uint64_t, uint64_t> >(w);
+            writeRecord(out, first, "AVLTree", w, &avl, NULL);
+            Timings stdMap = run<map<uint64_t, uint64_t> >(w);
+            writeRecord(out, first, "std::map", w, &stdMap, NULL);
+        }
+    }
+    out << "\n  ]\n}\n";
+    return 0;
+}
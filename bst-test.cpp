@@ -1,7 +1,13 @@
 #include <iostream>
+#include <functional>
 #include <map>
+#include <string>
 #include "bst.h"
 #include "avlbst.h"
+#include "rbbst.h"
+#include "splaybst.h"
+#include "treapbst.h"
+#include "compact_avlbst.h"
 
 using namespace std;
 
@@ -12,6 +18,10 @@ int main(int argc, char *argv[])
     BinarySearchTree<char,int> bt;
     bt.insert(std::make_pair('a',1));
     bt.insert(std::make_pair('b',2));
+    if(!bt.try_emplace('a', 5).second) {
+        cout << "try_emplace kept a = " << bt['a'] << endl;
+    }
+    bt.insert_or_assign('c', 3);
     
     cout << "Binary Search Tree contents:" << endl;
     for(BinarySearchTree<char,int>::iterator it = bt.begin(); it != bt.end(); ++it) {
@@ -23,6 +33,19 @@ int main(int argc, char *argv[])
     else {
         cout << "Did not find b" << endl;
     }
+    cout << "Size " << bt.size() << ", rank of b " << bt.rank('b')
+         << ", item 2 is " << bt.select(2)->first << endl;
+    cout << "Keys in [b, d):";
+    BinarySearchTree<char,int>::Range r = bt.range('b', 'd');
+    for(BinarySearchTree<char,int>::iterator it = r.begin(); it != r.end(); ++it) {
+        cout << " " << it->first;
+    }
+    cout << " (" << bt.countRange('b', 'd') << " keys)" << endl;
+    cout << "Reversed:";
+    for(BinarySearchTree<char,int>::reverse_iterator it = bt.rbegin(); it != bt.rend(); ++it) {
+        cout << " " << it->first;
+    }
+    cout << endl;
     cout << "Erasing b" << endl;
     bt.remove('b');
 
@@ -41,8 +64,83 @@ int main(int argc, char *argv[])
     else {
         cout << "Did not find b" << endl;
     }
+    AVLTree<char,int> upper;
+    at.split('b', upper);
+    cout << "Split at b: " << at.size() << " below, " << upper.size() << " at or above" << endl;
+    at.join(upper);
+    FrozenTree<char,int> frozen = at.freeze();
     cout << "Erasing b" << endl;
     at.remove('b');
+    cout << "Frozen snapshot still has b: " << (frozen.find('b') != frozen.end()) << endl;
+
+    // String keys are moved in and can be looked up without a copy
+    AVLTree<string,string> st;
+    st.insert(std::make_pair(string("one"), string("uno")));
+    st.emplace("two", "dos");
+    AVLTree<string,string> moved(std::move(st));
+    cout << "Moved tree has " << moved.size() << " items, two = " << moved.find("two")->second << endl;
+
+    // Keys ordered by a comparator, as with std::map
+    AVLTree<int,char,std::greater<int> > desc;
+    for(int i = 1; i <= 3; ++i) {
+        desc.insert(std::make_pair(i, (char)('a' + i - 1)));
+    }
+    cout << "Descending:";
+    for(AVLTree<int,char,std::greater<int> >::iterator it = desc.begin(); it != desc.end(); ++it) {
+        cout << " " << it->first;
+    }
+    cout << endl;
+
+    // Shape of a tree in one pass
+    TreeStats shape = desc.stats();
+    cout << "Stats: size " << shape.size << ", height " << shape.height
+         << ", average depth " << shape.averageDepth << endl;
+
+    // Red-black tree: at most three rotations per update
+    RBTree<int,int> rb;
+    for(int i = 0; i < 100; ++i) {
+        rb.insert(std::make_pair(i, i));
+    }
+    for(int i = 0; i < 100; i += 2) {
+        rb.remove(i);
+    }
+    cout << "RBTree has " << rb.size() << " items, height " << rb.stats().height << endl;
+
+    // Batched lookups: the searches of a batch run side by side
+    int wanted[] = {3, 4, 51};
+    RBTree<int,int>::iterator hits[3];
+    rb.findMany(wanted, wanted + 3, hits);
+    cout << "findMany:";
+    for(int i = 0; i < 3; ++i) {
+        cout << " " << wanted[i] << (hits[i] == rb.end() ? " missing" : " found");
+    }
+    cout << endl;
+    FrozenTree<int,int> frozenRb = rb.freeze();
+    FrozenTree<int,int>::iterator bounds[3];
+    frozenRb.lowerBoundMany(wanted, wanted + 3, bounds);
+    cout << "Frozen lowerBoundMany:";
+    for(int i = 0; i < 3; ++i) {
+        cout << " " << bounds[i]->first;
+    }
+    cout << endl;
+
+    // Self-adjusting trees: a lookup moves the key towards the root
+    SplayTree<int,int> splay;
+    Treap<int,int> treap;
+    for(int i = 0; i < 100; ++i) {
+        splay.insert(std::make_pair(i, i * i));
+        treap.insert(std::make_pair(i, i * i));
+    }
+    cout << "Splay tree 42 squared = " << splay.find(42)->second
+         << ", Treap 7 squared = " << treap.find(7)->second << endl;
+
+    // Compact AVL tree: 32-bit links and no parent pointers
+    CompactAVLTree<int,int> compact;
+    for(int i = 0; i < 100; ++i) {
+        compact.insert(std::make_pair(i, -i));
+    }
+    compact.remove(50);
+    cout << "Compact tree has " << compact.size() << " items, 51 -> " << compact[51] << endl;
 
     return 0;
 }
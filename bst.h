@@ -5,20 +5,33 @@
 #include <exception>
 #include <cstdlib>
 #include <utility>
+#include <type_traits>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <thread>
+#include "node_pool.h"
+#include "frozen_tree.h"
+#include "key_order.h"
+#include "tree_stats.h"
 
 /**
  * A templated class for a Node in a search tree.
- * The getters for parent/left/right are virtual so
- * that they can be overridden for future kinds of
- * search trees, such as Red Black trees, Splay trees,
- * and AVL trees.
+ * Node has no virtual functions, so it carries no vtable
+ * pointer and every getter inlines. Nodes for other kinds
+ * of search trees (AVL, Red Black, Splay trees) derive from
+ * it and hide parent/left/right with getters that return
+ * their own type; since the links are stored as Node
+ * pointers, the BinarySearchTree algorithms work on them
+ * unchanged.
  */
 template <typename Key, typename Value>
 class Node
 {
 public:
-    Node(const Key& key, const Value& value, Node<Key, Value>* parent);
-    virtual ~Node();
+    template<typename K, typename V>
+    Node(K&& key, V&& value, Node<Key, Value>* parent);
+    ~Node();
 
     const std::pair<const Key, Value>& getItem() const;
     std::pair<const Key, Value>& getItem();
@@ -26,20 +39,29 @@ public:
     const Value& getValue() const;
     Value& getValue();
 
-    virtual Node<Key, Value>* getParent() const;
-    virtual Node<Key, Value>* getLeft() const;
-    virtual Node<Key, Value>* getRight() const;
+    Node<Key, Value>* getParent() const;
+    Node<Key, Value>* getLeft() const;
+    Node<Key, Value>* getRight() const;
 
     void setParent(Node<Key, Value>* parent);
     void setLeft(Node<Key, Value>* left);
     void setRight(Node<Key, Value>* right);
     void setValue(const Value &value);
+    void setValue(Value&& value);
+
+#ifdef BST_SUBTREE_SIZE
+    std::size_t getSize() const;
+    void setSize(std::size_t size);
+#endif
 
 protected:
     std::pair<const Key, Value> item_;
     Node<Key, Value>* parent_;
     Node<Key, Value>* left_;
     Node<Key, Value>* right_;
+#ifdef BST_SUBTREE_SIZE
+    std::size_t size_;  // number of nodes in the subtree rooted here
+#endif
 };
 
 /*
@@ -49,16 +71,20 @@ protected:
 */
 
 /**
-* Explicit constructor for a node.
+* Explicit constructor for a node. The key and value are forwarded, so
+* temporaries are moved into the node rather than copied.
 */
 template<typename Key, typename Value>
-Node<Key, Value>::Node(const Key& key, const Value& value, Node<Key, Value>* parent) :
-    item_(key, value),
+template<typename K, typename V>
+Node<Key, Value>::Node(K&& key, V&& value, Node<Key, Value>* parent) :
+    item_(std::forward<K>(key), std::forward<V>(value)),
     parent_(parent),
     left_(NULL),
     right_(NULL)
 {
-
+#ifdef BST_SUBTREE_SIZE
+    size_ = 1;
+#endif
 }
 
 /**
@@ -118,7 +144,7 @@ Value& Node<Key, Value>::getValue()
 }
 
 /**
-* An implementation of the virtual function for retreiving the parent.
+* A getter for the parent.
 */
 template<typename Key, typename Value>
 Node<Key, Value>* Node<Key, Value>::getParent() const
@@ -127,7 +153,7 @@ Node<Key, Value>* Node<Key, Value>::getParent() const
 }
 
 /**
-* An implementation of the virtual function for retreiving the left child.
+* A getter for the left child.
 */
 template<typename Key, typename Value>
 Node<Key, Value>* Node<Key, Value>::getLeft() const
@@ -136,7 +162,7 @@ Node<Key, Value>* Node<Key, Value>::getLeft() const
 }
 
 /**
-* An implementation of the virtual function for retreiving the right child.
+* A getter for the right child.
 */
 template<typename Key, typename Value>
 Node<Key, Value>* Node<Key, Value>::getRight() const
@@ -180,6 +206,35 @@ void Node<Key, Value>::setValue(const Value& value)
     item_.second = value;
 }
 
+/**
+* A setter that moves the new value into the node.
+*/
+template<typename Key, typename Value>
+void Node<Key, Value>::setValue(Value&& value)
+{
+    item_.second = std::move(value);
+}
+
+#ifdef BST_SUBTREE_SIZE
+/**
+* A getter for the number of nodes in this node's subtree.
+*/
+template<typename Key, typename Value>
+std::size_t Node<Key, Value>::getSize() const
+{
+    return size_;
+}
+
+/**
+* A setter for the number of nodes in this node's subtree.
+*/
+template<typename Key, typename Value>
+void Node<Key, Value>::setSize(std::size_t size)
+{
+    size_ = size;
+}
+#endif
+
 /*
   ---------------------------------------
   End implementations for the Node class.
@@ -187,20 +242,43 @@ void Node<Key, Value>::setValue(const Value& value)
 */
 
 /**
-* A templated unbalanced binary search tree.
+* A templated unbalanced binary search tree. Keys are ordered by Compare,
+* as in std::map; see key_order.h.
 */
-template <typename Key, typename Value>
+template <typename Key, typename Value, typename Compare = std::less<Key>, typename Alloc = NodePool>
 class BinarySearchTree
 {
 public:
     BinarySearchTree(); //TODO
+    explicit BinarySearchTree(const Compare& comp);
+    template<typename InputIt>
+    BinarySearchTree(InputIt first, InputIt last, const Compare& comp = Compare());
+    BinarySearchTree(BinarySearchTree&& other);
+    BinarySearchTree& operator=(BinarySearchTree&& other);
     virtual ~BinarySearchTree(); //TODO
     virtual void insert(const std::pair<const Key, Value>& keyValuePair); //TODO
+    void insert(std::pair<const Key, Value>&& keyValuePair);
+    template<typename Pair>
+    typename std::enable_if<std::is_constructible<std::pair<Key, Value>, Pair&&>::value &&
+                            !std::is_same<typename std::decay<Pair>::type, std::pair<const Key, Value> >::value>::type
+    insert(Pair&& keyValuePair);
     virtual void remove(const Key& key); //TODO
+    template<typename InputIt>
+    void assign(InputIt first, InputIt last);
+    template<typename InputIt>
+    void assignParallel(InputIt first, InputIt last, unsigned threads = 0);
+    template<typename InputIt>
+    void insertBatch(InputIt first, InputIt last);
+    template<typename InputIt>
+    void removeBatch(InputIt first, InputIt last);
     void clear(); //TODO
     bool isBalanced() const; //TODO
     void print() const;
     bool empty() const;
+    std::size_t size() const;
+    Compare key_comp() const;
+    TreeStats stats() const;
+    void resetOperationCounts();
 
     template<typename PPKey, typename PPValue>
     friend void prettyPrintBST(BinarySearchTree<PPKey, PPValue> & tree);
@@ -211,6 +289,12 @@ public:
     class iterator  // TODO
     {
     public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef std::pair<const Key, Value> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef std::pair<const Key, Value>* pointer;
+        typedef std::pair<const Key, Value>& reference;
+
         iterator();
 
         std::pair<const Key,Value>& operator*() const;
@@ -220,40 +304,164 @@ public:
         bool operator!=(const iterator& rhs) const;
 
         iterator& operator++();
+        iterator operator++(int);
+        iterator& operator--();
+        iterator operator--(int);
 
     protected:
-        friend class BinarySearchTree<Key, Value>;
-        iterator(Node<Key,Value>* ptr);
+        friend class BinarySearchTree<Key, Value, Compare, Alloc>;
+        iterator(Node<Key,Value>* ptr, const BinarySearchTree<Key, Value, Compare, Alloc>* tree);
         Node<Key, Value> *current_;
+        // only needed so that --end() can find the largest item
+        const BinarySearchTree<Key, Value, Compare, Alloc>* tree_;
+    };
+
+    typedef std::reverse_iterator<iterator> reverse_iterator;
+
+    /**
+    * The items with keys in [lo, hi), for use in a range-based for loop.
+    */
+    class Range
+    {
+    public:
+        Range(const iterator& first, const iterator& last);
+        iterator begin() const;
+        iterator end() const;
+
+    private:
+        iterator first_;
+        iterator last_;
     };
 
 public:
     iterator begin() const;
     iterator end() const;
+    reverse_iterator rbegin() const;
+    reverse_iterator rend() const;
+    template<typename Visitor>
+    void forEach(Visitor visit) const;
     iterator find(const Key& key) const;
+    iterator lower_bound(const Key& key) const;
+    iterator upper_bound(const Key& key) const;
+    std::pair<iterator, iterator> equal_range(const Key& key) const;
+    template<typename K>
+    typename std::enable_if<IsLookupKey<Key, K, Compare>::value, iterator>::type find(const K& key) const;
+    template<typename K>
+    typename std::enable_if<IsLookupKey<Key, K, Compare>::value, iterator>::type lower_bound(const K& key) const;
+    template<typename K>
+    typename std::enable_if<IsLookupKey<Key, K, Compare>::value, iterator>::type upper_bound(const K& key) const;
+    template<typename K>
+    typename std::enable_if<IsLookupKey<Key, K, Compare>::value, std::pair<iterator, iterator> >::type
+    equal_range(const K& key) const;
+    template<typename InputIt, typename OutputIt>
+    OutputIt findMany(InputIt first, InputIt last, OutputIt out) const;
+    Range range(const Key& lo, const Key& hi) const;
+    std::size_t countRange(const Key& lo, const Key& hi) const;
+    std::pair<iterator, bool> insert_or_assign(const Key& key, const Value& value);
+    std::pair<iterator, bool> insert_or_assign(Key&& key, Value&& value);
+    std::pair<iterator, bool> try_emplace(const Key& key, const Value& value);
+    std::pair<iterator, bool> try_emplace(Key&& key, Value&& value);
+    template<typename... Args>
+    std::pair<iterator, bool> emplace(Args&&... args);
     Value& operator[](const Key& key);
     Value const & operator[](const Key& key) const;
+    std::size_t rank(const Key& key) const;
+    iterator select(std::size_t k) const;
+    FrozenTree<Key, Value, Compare> freeze() const;
 
 protected:
     // Mandatory helper functions
-    Node<Key, Value>* internalFind(const Key& k) const; // TODO
+    template<typename K>
+    Node<Key, Value>* internalFind(const K& k) const; // TODO
+    template<typename K>
+    Node<Key, Value>* lowerBoundNode(const K& key) const;
+    template<typename K>
+    Node<Key, Value>* upperBoundNode(const K& key) const;
     Node<Key, Value> *getSmallestNode() const;  // TODO
+    Node<Key, Value> *getLargestNode() const;
     static Node<Key, Value>* predecessor(Node<Key, Value>* current); // TODO
+    static Node<Key, Value>* successor(Node<Key, Value>* current);
+    iterator iteratorAt(Node<Key, Value>* n) const;
+
+    // Subtree size upkeep; these do nothing unless BST_SUBTREE_SIZE is defined
+    static std::size_t subtreeSize(Node<Key, Value>* n);
+    static void resetSize(Node<Key, Value>* n);
+    static void adjustPathSizes(Node<Key, Value>* n, int delta);
+    void invalidateCount();
+    // Key comparisons through comp_, with one three-way result per node
+    // in the descents
+    template<typename A, typename B>
+    bool keyLess(const A& a, const B& b) const;
+    template<typename A, typename B>
+    int compareKeys(const A& a, const B& b) const;
+    // Adds to an operation counter; does nothing unless BST_STATS is defined
+    void count(OperationCounts::Kind kind, std::size_t by = 1) const;
+    // Hint that n is about to be read; a no-op where the compiler has no prefetch
+    static void prefetchNode(const Node<Key, Value>* n);
     // Note:  static means these functions don't have a "this" pointer
     //        and instead just use the input argument.
 
+    virtual Node<Key, Value>* internalInsert(const Key& key, const Value& value, bool overwrite, bool& inserted);
+    virtual Node<Key, Value>* internalInsert(Key&& key, Value&& value, bool overwrite, bool& inserted);
+    template<typename K, typename V>
+    Node<Key, Value>* insertItem(K&& key, V&& value, bool overwrite, bool& inserted);
+    void takeTree(BinarySearchTree& other);
+
     // Provided helper functions
     virtual void printRoot (Node<Key, Value> *r) const;
     virtual void nodeSwap( Node<Key,Value>* n1, Node<Key,Value>* n2) ;
+    // Single rotation that lifts n above its parent, for the trees that
+    // rebalance by rotating one node at a time (splay tree, treap)
+    void rotateUp(Node<Key, Value>* n);
+
+    // Node storage goes through alloc_ so nodes can be pooled
+    template<typename NodeType, typename K, typename V>
+    NodeType* createNode(K&& key, V&& value, NodeType* parent);
+    template<typename NodeType, typename K, typename V>
+    static NodeType* constructNode(Alloc& alloc, K&& key, V&& value, NodeType* parent);
+    template<typename NodeType>
+    void destroyNodeAs(NodeType* n);
+    virtual void destroyNode(Node<Key, Value>* n);
+    virtual Node<Key, Value>* createBuiltNode(Alloc& alloc, const Key& key, const Value& value, Node<Key, Value>* parent,
+                                              int8_t balance, int height) const;
+    template<typename InputIt>
+    void assignRange(InputIt first, InputIt last, unsigned threads, std::input_iterator_tag);
+    template<typename RandomIt>
+    void assignRange(RandomIt first, RandomIt last, unsigned threads, std::random_access_iterator_tag);
+    void sortUniqueItems(std::vector<std::pair<Key, Value> >& items) const;
+    bool preferRebuild(std::size_t batchSize) const;
+    template<typename RandomIt>
+    void buildTree(RandomIt items, std::size_t count, unsigned threads);
+    template<typename RandomIt>
+    Node<Key, Value>* buildSubtree(RandomIt items, std::size_t lo, std::size_t hi, Node<Key, Value>* parent, Alloc& alloc) const;
+    template<typename RandomIt>
+    Node<Key, Value>* buildSubtreeParallel(RandomIt items, std::size_t lo, std::size_t hi, Node<Key, Value>* parent,
+                                           Alloc& alloc, unsigned threads) const;
+    static int builtHeight(std::size_t count);
+    static unsigned threadCount(unsigned threads);
+    // below this many items a subtree is not worth a thread of its own
+    static const std::size_t PARALLEL_MIN_ITEMS = 1 << 15;
+    // searches findMany() runs side by side
+    static const std::size_t FIND_GROUP = 16;
 
     // Add helper functions here
     void clearHelper(Node<Key, Value>* n);
     Node<Key, Value> *getSmallestNodeHelper(Node<Key, Value>* n) const;
-    int isBalancedHelper(Node<Key, Value>* n) const;
+    bool isBalancedHelper(Node<Key, Value>* n) const;
 
 
 protected:
     Node<Key, Value>* root_;
+    Compare comp_;
+    Alloc alloc_;
+    // exact unless countStale_, which split() may leave behind when
+    // subtree sizes are not kept; size() then recounts once
+    mutable std::size_t nodeCount_;
+    mutable bool countStale_;
+#ifdef BST_STATS
+    // mutable so that lookups can count too
+    mutable OperationCounter counter_;
+#endif
     // You should not need other data members
 };
 
@@ -266,30 +474,33 @@ Begin implementations for the BinarySearchTree::iterator class.
 /**
 * Explicit constructor that initializes an iterator with a given node pointer.
 */
-template<class Key, class Value>
-BinarySearchTree<Key, Value>::iterator::iterator(Node<Key,Value> *ptr)
+template<class Key, class Value, class Compare, class Alloc>
+BinarySearchTree<Key, Value, Compare, Alloc>::iterator::iterator(Node<Key,Value> *ptr,
+    const BinarySearchTree<Key, Value, Compare, Alloc>* tree)
 {
     // TODO
     current_ = ptr;
+    tree_ = tree;
 }
 
 /**
 * A default constructor that initializes the iterator to NULL.
 */
-template<class Key, class Value>
-BinarySearchTree<Key, Value>::iterator::iterator() 
+template<class Key, class Value, class Compare, class Alloc>
+BinarySearchTree<Key, Value, Compare, Alloc>::iterator::iterator() 
 {
     // TODO
     current_ = NULL;
+    tree_ = NULL;
 
 }
 
 /**
 * Provides access to the item.
 */
-template<class Key, class Value>
+template<class Key, class Value, class Compare, class Alloc>
 std::pair<const Key,Value> &
-BinarySearchTree<Key, Value>::iterator::operator*() const
+BinarySearchTree<Key, Value, Compare, Alloc>::iterator::operator*() const
 {
     return current_->getItem();
 }
@@ -297,9 +508,9 @@ BinarySearchTree<Key, Value>::iterator::operator*() const
 /**
 * Provides access to the address of the item.
 */
-template<class Key, class Value>
+template<class Key, class Value, class Compare, class Alloc>
 std::pair<const Key,Value> *
-BinarySearchTree<Key, Value>::iterator::operator->() const
+BinarySearchTree<Key, Value, Compare, Alloc>::iterator::operator->() const
 {
     return &(current_->getItem());
 }
@@ -308,10 +519,10 @@ BinarySearchTree<Key, Value>::iterator::operator->() const
 * Checks if 'this' iterator's internals have the same value
 * as 'rhs'
 */
-template<class Key, class Value>
+template<class Key, class Value, class Compare, class Alloc>
 bool
-BinarySearchTree<Key, Value>::iterator::operator==(
-    const BinarySearchTree<Key, Value>::iterator& rhs) const
+BinarySearchTree<Key, Value, Compare, Alloc>::iterator::operator==(
+    const BinarySearchTree<Key, Value, Compare, Alloc>::iterator& rhs) const
 {
     // TODO
     return (current_ == rhs.current_);
@@ -321,10 +532,10 @@ BinarySearchTree<Key, Value>::iterator::operator==(
 * Checks if 'this' iterator's internals have a different value
 * as 'rhs'
 */
-template<class Key, class Value>
+template<class Key, class Value, class Compare, class Alloc>
 bool
-BinarySearchTree<Key, Value>::iterator::operator!=(
-    const BinarySearchTree<Key, Value>::iterator& rhs) const
+BinarySearchTree<Key, Value, Compare, Alloc>::iterator::operator!=(
+    const BinarySearchTree<Key, Value, Compare, Alloc>::iterator& rhs) const
 {
     // TODO
     return (current_ != rhs.current_);
@@ -335,33 +546,82 @@ BinarySearchTree<Key, Value>::iterator::operator!=(
 /**
 * Advances the iterator's location using an in-order sequencing
 */
-template<class Key, class Value>
-typename BinarySearchTree<Key, Value>::iterator&
-BinarySearchTree<Key, Value>::iterator::operator++()
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator&
+BinarySearchTree<Key, Value, Compare, Alloc>::iterator::operator++()
 {
     // TODO
-    if (current_ == NULL){
-      return *this;
+    if (current_ != NULL){
+      current_ = successor(current_);
     }
-    else if (current_->getRight() != NULL)
-    {
-        current_ = current_->getRight();
-        while (current_->getLeft() != NULL){
-          current_ = current_->getLeft();
-        }
-    }
-    else
-    {
-        Node<Key, Value>* p = current_->getParent();
-        while ((p != NULL) && (current_ == p->getRight())){
-          current_ = p;
-          p = p->getParent();
-        }
-        current_ = p;
+    return *this;
+}
+
+/**
+* Postfix version of operator++
+*/
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::iterator::operator++(int)
+{
+    iterator old(*this);
+    ++(*this);
+    return old;
+}
+
+/**
+* Moves the iterator back to the previous item in order. Decrementing
+* the end iterator gives the largest item.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator&
+BinarySearchTree<Key, Value, Compare, Alloc>::iterator::operator--()
+{
+    if (current_ != NULL){
+      current_ = predecessor(current_);
+    }else if (tree_ != NULL){
+      current_ = tree_->getLargestNode();
     }
     return *this;
 }
 
+/**
+* Postfix version of operator--
+*/
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::iterator::operator--(int)
+{
+    iterator old(*this);
+    --(*this);
+    return old;
+}
+
+
+/**
+* Constructs a range covering [first, last).
+*/
+template<class Key, class Value, class Compare, class Alloc>
+BinarySearchTree<Key, Value, Compare, Alloc>::Range::Range(const iterator& first, const iterator& last) :
+    first_(first),
+    last_(last)
+{
+
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::Range::begin() const
+{
+    return first_;
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::Range::end() const
+{
+    return last_;
+}
 
 /*
 -------------------------------------------------------------
@@ -378,316 +638,1581 @@ Begin implementations for the BinarySearchTree class.
 /**
 * Default constructor for a BinarySearchTree, which sets the root to NULL.
 */
-template<class Key, class Value>
-BinarySearchTree<Key, Value>::BinarySearchTree() 
+template<class Key, class Value, class Compare, class Alloc>
+BinarySearchTree<Key, Value, Compare, Alloc>::BinarySearchTree() 
 {
     // TODO
     root_ = NULL;
+    nodeCount_ = 0;
+    countStale_ = false;
 }
 
-template<typename Key, typename Value>
-BinarySearchTree<Key, Value>::~BinarySearchTree()
+/**
+* Constructor for an empty tree that orders its keys with comp.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+BinarySearchTree<Key, Value, Compare, Alloc>::BinarySearchTree(const Compare& comp) :
+    comp_(comp)
 {
-    // TODO
-    clear();
-
+    root_ = NULL;
+    nodeCount_ = 0;
+    countStale_ = false;
 }
 
-
 /**
- * Returns true if tree is empty
+* Range constructor; builds a balanced tree from key/value pairs.
+* See assign().
 */
-template<class Key, class Value>
-bool BinarySearchTree<Key, Value>::empty() const
+template<class Key, class Value, class Compare, class Alloc>
+template<typename InputIt>
+BinarySearchTree<Key, Value, Compare, Alloc>::BinarySearchTree(InputIt first, InputIt last, const Compare& comp) :
+    comp_(comp)
 {
-    return root_ == NULL;
+    root_ = NULL;
+    nodeCount_ = 0;
+    countStale_ = false;
+    assign(first, last);
 }
 
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::print() const
+/**
+* Move constructor; takes over other's nodes in O(1) and leaves other empty.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+BinarySearchTree<Key, Value, Compare, Alloc>::BinarySearchTree(BinarySearchTree&& other) :
+    comp_(other.comp_)
 {
-    printRoot(root_);
-    std::cout << "\n";
+    root_ = NULL;
+    nodeCount_ = 0;
+    countStale_ = false;
+    takeTree(other);
 }
 
 /**
-* Returns an iterator to the "smallest" item in the tree
+* Move assignment; frees this tree's nodes, then takes over other's in
+* O(1) and leaves other empty.
 */
-template<class Key, class Value>
-typename BinarySearchTree<Key, Value>::iterator
-BinarySearchTree<Key, Value>::begin() const
+template<class Key, class Value, class Compare, class Alloc>
+BinarySearchTree<Key, Value, Compare, Alloc>&
+BinarySearchTree<Key, Value, Compare, Alloc>::operator=(BinarySearchTree&& other)
 {
-    BinarySearchTree<Key, Value>::iterator begin(getSmallestNode());
-    return begin;
+    if (&other != this){
+      clear();
+      comp_ = other.comp_;
+      takeTree(other);
+    }
+    return *this;
 }
 
 /**
-* Returns an iterator whose value means INVALID
+* Makes this (empty) tree the owner of other's nodes. The allocators
+* share first, so the nodes stay valid once other lets its memory go.
 */
-template<class Key, class Value>
-typename BinarySearchTree<Key, Value>::iterator
-BinarySearchTree<Key, Value>::end() const
+template<class Key, class Value, class Compare, class Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::takeTree(BinarySearchTree& other)
 {
-    BinarySearchTree<Key, Value>::iterator end(NULL);
-    return end;
+    alloc_.share(other.alloc_);
+    root_ = other.root_;
+    nodeCount_ = other.nodeCount_;
+    countStale_ = other.countStale_;
+    other.root_ = NULL;
+    other.nodeCount_ = 0;
+    other.countStale_ = false;
+    other.alloc_.release();
+}
+
+template<typename Key, typename Value, typename Compare, typename Alloc>
+BinarySearchTree<Key, Value, Compare, Alloc>::~BinarySearchTree()
+{
+    // TODO
+    clear();
+
 }
 
+
 /**
-* Returns an iterator to the item with the given key, k
-* or the end iterator if k does not exist in the tree
+ * Returns true if tree is empty
 */
-template<class Key, class Value>
-typename BinarySearchTree<Key, Value>::iterator
-BinarySearchTree<Key, Value>::find(const Key & k) const
+template<class Key, class Value, class Compare, class Alloc>
+bool BinarySearchTree<Key, Value, Compare, Alloc>::empty() const
 {
-    Node<Key, Value> *curr = internalFind(k);
-    BinarySearchTree<Key, Value>::iterator it(curr);
-    return it;
+    return root_ == NULL;
 }
 
 /**
- * @precondition The key exists in the map
- * Returns the value associated with the key
- */
-template<class Key, class Value>
-Value& BinarySearchTree<Key, Value>::operator[](const Key& key)
+ * Returns the number of items in the tree
+*/
+template<class Key, class Value, class Compare, class Alloc>
+std::size_t BinarySearchTree<Key, Value, Compare, Alloc>::size() const
 {
-    Node<Key, Value> *curr = internalFind(key);
-    if(curr == NULL) throw std::out_of_range("Invalid key");
-    return curr->getValue();
+    if (countStale_){
+      std::size_t count = 0;
+      forEach([&count](const std::pair<const Key, Value>&){ ++count; });
+      nodeCount_ = count;
+      countStale_ = false;
+    }
+    return nodeCount_;
 }
-template<class Key, class Value>
-Value const & BinarySearchTree<Key, Value>::operator[](const Key& key) const
+
+/**
+ * Returns a copy of the object that orders the keys
+*/
+template<class Key, class Value, class Compare, class Alloc>
+Compare BinarySearchTree<Key, Value, Compare, Alloc>::key_comp() const
 {
-    Node<Key, Value> *curr = internalFind(key);
-    if(curr == NULL) throw std::out_of_range("Invalid key");
-    return curr->getValue();
+    return comp_;
 }
 
 /**
-* An insert method to insert into a Binary Search Tree.
-* The tree will not remain balanced when inserting.
-* Recall: If key is already in the tree, you should 
-* overwrite the current value with the updated value.
+ * Returns the tree's size, height, average node depth and a histogram
+ * of node balances (height(right) - height(left)), found in one
+ * post-order walk that climbs parent pointers instead of recursing, plus
+ * the operation counts kept under BST_STATS.
 */
-template<class Key, class Value>
-void BinarySearchTree<Key, Value>::insert(const std::pair<const Key, Value> &keyValuePair)
+template<class Key, class Value, class Compare, class Alloc>
+TreeStats BinarySearchTree<Key, Value, Compare, Alloc>::stats() const
 {
-    // TODO
-    Node<Key, Value>* temp = this->internalFind(keyValuePair.first);
-    if (temp != NULL){
-       temp->setValue(keyValuePair.second);
-       return;
-    }
-    if (root_ == NULL) {
-      root_ = new Node<Key, Value>(keyValuePair.first, keyValuePair.second, NULL);
-      return;
+    TreeStats result;
+#ifdef BST_STATS
+    result.operations = counter_.read();
+#endif
+    Node<Key, Value>* n = root_;
+    if (n == NULL){
+      return result;
     }
-    Node<Key, Value>* r = root_;
-    Node<Key, Value>* p = NULL;
-    Node<Key, Value>* n = new Node<Key, Value>(keyValuePair.first, keyValuePair.second, NULL);
-    while (r != NULL){
-      p = r;
-      if (r->getKey() > keyValuePair.first){
-        r = r->getLeft();
+    // heights of the finished left and right subtrees of the node at each depth
+    std::vector<int> leftHeight;
+    std::vector<int> rightHeight;
+    Node<Key, Value>* prev = NULL;
+    std::size_t depth = 0;
+    std::size_t depthSum = 0;
+    int finished = 0;
+    while (n != NULL){
+      Node<Key, Value>* next;
+      if (prev == n->getParent()){
+        if (leftHeight.size() <= depth){
+          leftHeight.push_back(0);
+          rightHeight.push_back(0);
+        }
+        leftHeight[depth] = 0;
+        rightHeight[depth] = 0;
+        ++result.size;
+        depthSum += depth;
+        if (depth + 1 > result.height){
+          result.height = depth + 1;
+        }
+        next = (n->getLeft() != NULL) ? n->getLeft() : n->getRight();
+      }else if (prev == n->getLeft()){
+        leftHeight[depth] = finished;
+        next = n->getRight();
       }else{
-        r = r->getRight();
+        rightHeight[depth] = finished;
+        next = NULL;
       }
+      if (next != NULL){
+        prev = n;
+        n = next;
+        ++depth;
+        continue;
+      }
+      int l = leftHeight[depth];
+      int r = rightHeight[depth];
+      ++result.balanceHistogram[r - l];
+      finished = ((l > r) ? l : r) + 1;
+      prev = n;
+      n = n->getParent();
+      --depth;
     }
-    if (keyValuePair.first < p->getKey()){
-      p->setLeft(n);
-    }else{
-      p->setRight(n);
-    }
-    n->setParent(p);
-
+    result.averageDepth = (double)depthSum / (double)result.size;
+    return result;
 }
 
-
 /**
-* A remove method to remove a specific key from a Binary Search Tree.
-* Recall: The writeup specifies that if a node has 2 children you
-* should swap with the predecessor and then remove.
+ * Sets every operation count back to zero (see stats()).
 */
-
-template<class Key, class Value>
-void BinarySearchTree<Key, Value>::remove(const Key& key) {
-    Node<Key, Value>* nodeToRemove = internalFind(key);
-    if (nodeToRemove == nullptr) {
-        return;
-    }
-    if (nodeToRemove->getLeft() != nullptr && nodeToRemove->getRight() != nullptr) {
-        Node<Key, Value>* pred = predecessor(nodeToRemove);
-        nodeSwap(nodeToRemove, pred);
-    }
-    Node<Key, Value>* child = (nodeToRemove->getLeft() != nullptr) ? nodeToRemove->getLeft() : nodeToRemove->getRight();
-    if (child == nullptr) {
-        if (nodeToRemove == root_) {
-            root_ = nullptr;
-        } else {
-            Node<Key, Value>* parent = nodeToRemove->getParent();
-            if (parent->getLeft() == nodeToRemove) {
-                parent->setLeft(nullptr);
-            } else {
-                parent->setRight(nullptr);
-            }
-        }
-    } else {
-        if (nodeToRemove == root_) {
-            root_ = child;
-            root_->setParent(nullptr); 
-        } else {
-            Node<Key, Value>* parent = nodeToRemove->getParent();
-            if (parent->getLeft() == nodeToRemove) {
-                parent->setLeft(child);
-            } else {
-                parent->setRight(child);
-            }
-            child->setParent(parent);
-        }
-    }
-    delete nodeToRemove;
+template<class Key, class Value, class Compare, class Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::resetOperationCounts()
+{
+#ifdef BST_STATS
+    counter_.reset();
+#endif
 }
 
-
-
-template<class Key, class Value>
-Node<Key, Value>*
-BinarySearchTree<Key, Value>::predecessor(Node<Key, Value>* current)
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::print() const
 {
-    // TODO
-    if (current->getLeft() != NULL){
-      Node<Key, Value>* temp = current->getLeft();
-      while(temp->getRight() != NULL){
-        temp = temp->getRight();
-      }
-      return temp;
-    }else{
-      Node<Key, Value>* p = current->getParent();
-      while((p != NULL) && (current == p->getLeft())){
-        current = p;
-        p = p->getParent();
-      }
-      return p;
-    }
-
+    printRoot(root_);
+    std::cout << "\n";
 }
 
-
 /**
-* A method to remove all contents of the tree and
-* reset the values in the tree for use again.
+* Returns an iterator to the "smallest" item in the tree
 */
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::clear()
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::begin() const
 {
-    // TODO
-    clearHelper(root_);
-    root_ = nullptr;
+    BinarySearchTree<Key, Value, Compare, Alloc>::iterator begin(getSmallestNode(), this);
+    return begin;
 }
 
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::clearHelper(Node<Key, Value>* n)
+/**
+* Returns an iterator whose value means INVALID
+*/
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::end() const
 {
-  if (n == nullptr){
-    return;
-  }
-  clearHelper(n->getLeft());
-  clearHelper(n->getRight());
-  delete n;
-
+    BinarySearchTree<Key, Value, Compare, Alloc>::iterator end(NULL, this);
+    return end;
 }
 
-
 /**
-* A helper function to find the smallest node in the tree.
+* Returns a reverse iterator to the largest item in the tree
 */
-template<typename Key, typename Value>
-Node<Key, Value>*
-BinarySearchTree<Key, Value>::getSmallestNode() const
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::reverse_iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::rbegin() const
 {
-    // TODO
-    if (root_ == NULL){
-      return NULL;
-    }
-    return getSmallestNodeHelper(root_);
+    return reverse_iterator(end());
 }
 
-template<typename Key, typename Value>
-Node<Key, Value>* 
-BinarySearchTree<Key, Value>::getSmallestNodeHelper(Node<Key, Value>* n) const
+/**
+* Returns a reverse iterator one before the smallest item
+*/
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::reverse_iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::rend() const
 {
-  if (n == NULL){
-    return NULL;
-  }else if(n->getLeft() == NULL){
-    return n;
-  }
-  return getSmallestNodeHelper(n->getLeft());
+    return reverse_iterator(begin());
 }
 
 /**
-* Helper function to find a node with given key, k and
-* return a pointer to it or NULL if no item with that key
-* exists
+* Calls visit(item) on every item in key order. Keeps the path to the
+* current node on an explicit stack instead of climbing parent pointers
+* like iterator::operator++, so a full scan makes fewer dependent loads
+* and runs several times faster on large trees. The tree must not be
+* modified during the scan (values may be).
 */
-template<typename Key, typename Value>
-Node<Key, Value>* BinarySearchTree<Key, Value>::internalFind(const Key& key) const
+template<class Key, class Value, class Compare, class Alloc>
+template<typename Visitor>
+void BinarySearchTree<Key, Value, Compare, Alloc>::forEach(Visitor visit) const
 {
-    // TODO
-    Node<Key, Value>* temp = root_;
-    while (temp != NULL){
-      if (temp->getKey() == key){
-        return temp;
-      }else if (temp->getKey() < key){
-        temp = temp->getRight();
-      }else{
-        temp = temp->getLeft();
+    std::vector<Node<Key, Value>*> path;
+    path.reserve(64);
+    Node<Key, Value>* curr = root_;
+    while (curr != NULL || !path.empty()){
+      while (curr != NULL){
+        path.push_back(curr);
+        curr = curr->getLeft();
       }
+      curr = path.back();
+      path.pop_back();
+      visit(curr->getItem());
+      curr = curr->getRight();
     }
-    return NULL;
-    
 }
 
 /**
- * Return true iff the BST is balanced.
- */
-template<typename Key, typename Value>
-bool BinarySearchTree<Key, Value>::isBalanced() const
+* Returns a read-only copy of the tree laid out for fast lookups (see
+* frozen_tree.h). Later changes to the tree do not affect it.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+FrozenTree<Key, Value, Compare> BinarySearchTree<Key, Value, Compare, Alloc>::freeze() const
 {
-    // TODO
-  return (isBalancedHelper(root_) != -1);
+    std::vector<std::pair<const Key, Value> > items;
+    items.reserve(size());
+    forEach([&items](const std::pair<const Key, Value>& item){
+      items.push_back(item);
+    });
+    return FrozenTree<Key, Value, Compare>(items, comp_);
 }
 
-template<typename Key, typename Value>
-int BinarySearchTree<Key, Value>::isBalancedHelper(Node<Key, Value>* n) const
-{
-  if (n == NULL){
-    return 0;
+/**
+* Returns an iterator to the item with the given key, k
+* or the end iterator if k does not exist in the tree
+*/
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::find(const Key & k) const
+{
+    Node<Key, Value> *curr = internalFind(k);
+    BinarySearchTree<Key, Value, Compare, Alloc>::iterator it(curr, this);
+    return it;
+}
+
+/**
+* Returns an iterator to the first item whose key is not less than key,
+* or the end iterator if there is none
+*/
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::lower_bound(const Key& key) const
+{
+    return iterator(lowerBoundNode(key), this);
+}
+
+/**
+* Returns an iterator to the first item whose key is greater than key,
+* or the end iterator if there is none
+*/
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::upper_bound(const Key& key) const
+{
+    return iterator(upperBoundNode(key), this);
+}
+
+/**
+* Returns the [lower_bound, upper_bound) pair for key, which holds
+* at most one item since keys are unique
+*/
+template<class Key, class Value, class Compare, class Alloc>
+std::pair<typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator,
+          typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator>
+BinarySearchTree<Key, Value, Compare, Alloc>::equal_range(const Key& key) const
+{
+    return std::make_pair(lower_bound(key), upper_bound(key));
+}
+
+/**
+* find() by any key type that orders against Key (see IsLookupKey),
+* e.g. a std::string_view in a tree of std::string, without building a
+* temporary Key.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+template<typename K>
+typename std::enable_if<IsLookupKey<Key, K, Compare>::value, typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator>::type
+BinarySearchTree<Key, Value, Compare, Alloc>::find(const K& key) const
+{
+    return iterator(internalFind(key), this);
+}
+
+/**
+* Looks up every key in [first, last) and writes an iterator for each,
+* in order, to out: the item with that key, or end() if it is missing.
+* Returns out past the last iterator written.
+*
+* The keys are searched FIND_GROUP at a time in lockstep. Each round
+* takes every unfinished search one level down and prefetches the node
+* it lands on, so the cache misses of a whole group overlap instead of
+* being paid one after the other. Like the const find(), this leaves a
+* self-adjusting tree (SplayTree, Treap) as it is.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+template<typename InputIt, typename OutputIt>
+OutputIt BinarySearchTree<Key, Value, Compare, Alloc>::findMany(InputIt first, InputIt last, OutputIt out) const
+{
+    std::vector<Key> keys;
+    keys.reserve(FIND_GROUP);
+    Node<Key, Value>* at[FIND_GROUP];
+    Node<Key, Value>* found[FIND_GROUP];
+    while (first != last){
+      keys.clear();
+      while (keys.size() < FIND_GROUP && first != last){
+        keys.push_back(*first);
+        ++first;
+      }
+      std::size_t lanes = keys.size();
+      for (std::size_t i = 0; i < lanes; ++i){
+        at[i] = root_;
+        found[i] = NULL;
+      }
+      std::size_t searching = (root_ != NULL) ? lanes : 0;
+      while (searching > 0){
+        for (std::size_t i = 0; i < lanes; ++i){
+          Node<Key, Value>* n = at[i];
+          if (n == NULL){
+            continue;
+          }
+          count(OperationCounts::NODES_VISITED);
+          int c = compareKeys(keys[i], n->getKey());
+          Node<Key, Value>* next = (c < 0) ? n->getLeft() : n->getRight();
+          if (c == 0){
+            found[i] = n;
+            next = NULL;
+          }
+          if (next == NULL){
+            --searching;
+          }
+          prefetchNode(next);
+          at[i] = next;
+        }
+      }
+      for (std::size_t i = 0; i < lanes; ++i){
+        *out = iterator(found[i], this);
+        ++out;
+      }
+    }
+    return out;
+}
+
+/**
+* lower_bound() by any key type that orders against Key
+*/
+template<class Key, class Value, class Compare, class Alloc>
+template<typename K>
+typename std::enable_if<IsLookupKey<Key, K, Compare>::value, typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator>::type
+BinarySearchTree<Key, Value, Compare, Alloc>::lower_bound(const K& key) const
+{
+    return iterator(lowerBoundNode(key), this);
+}
+
+/**
+* upper_bound() by any key type that orders against Key
+*/
+template<class Key, class Value, class Compare, class Alloc>
+template<typename K>
+typename std::enable_if<IsLookupKey<Key, K, Compare>::value, typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator>::type
+BinarySearchTree<Key, Value, Compare, Alloc>::upper_bound(const K& key) const
+{
+    return iterator(upperBoundNode(key), this);
+}
+
+/**
+* equal_range() by any key type that orders against Key
+*/
+template<class Key, class Value, class Compare, class Alloc>
+template<typename K>
+typename std::enable_if<IsLookupKey<Key, K, Compare>::value,
+                        std::pair<typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator,
+                                  typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator> >::type
+BinarySearchTree<Key, Value, Compare, Alloc>::equal_range(const K& key) const
+{
+    return std::make_pair(iterator(lowerBoundNode(key), this), iterator(upperBoundNode(key), this));
+}
+
+/**
+* An iterator at n (end() for NULL), for subclasses, which cannot use the
+* iterator constructor themselves
+*/
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::iteratorAt(Node<Key, Value>* n) const
+{
+    return iterator(n, this);
+}
+
+/**
+* The first node whose key is not less than key, or NULL if there is none
+*/
+template<class Key, class Value, class Compare, class Alloc>
+template<typename K>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare, Alloc>::lowerBoundNode(const K& key) const
+{
+    Node<Key, Value>* result = NULL;
+    Node<Key, Value>* curr = root_;
+    while (curr != NULL){
+      count(OperationCounts::NODES_VISITED);
+      if (keyLess(curr->getKey(), key)){
+        curr = curr->getRight();
+      }else{
+        result = curr;
+        curr = curr->getLeft();
+      }
+    }
+    return result;
+}
+
+/**
+* The first node whose key is greater than key, or NULL if there is none
+*/
+template<class Key, class Value, class Compare, class Alloc>
+template<typename K>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare, Alloc>::upperBoundNode(const K& key) const
+{
+    Node<Key, Value>* result = NULL;
+    Node<Key, Value>* curr = root_;
+    while (curr != NULL){
+      count(OperationCounts::NODES_VISITED);
+      if (keyLess(key, curr->getKey())){
+        result = curr;
+        curr = curr->getLeft();
+      }else{
+        curr = curr->getRight();
+      }
+    }
+    return result;
+}
+
+/**
+* Returns the items with keys in [lo, hi) in key order. Finding the
+* ends is O(log n); the items are then streamed by iterator::operator++.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::Range
+BinarySearchTree<Key, Value, Compare, Alloc>::range(const Key& lo, const Key& hi) const
+{
+    if (!keyLess(lo, hi)){
+      return Range(end(), end());
+    }
+    return Range(lower_bound(lo), lower_bound(hi));
+}
+
+/**
+* Returns the number of keys in [lo, hi). O(log n) with BST_SUBTREE_SIZE,
+* otherwise O(log n) plus the number of keys counted.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+std::size_t BinarySearchTree<Key, Value, Compare, Alloc>::countRange(const Key& lo, const Key& hi) const
+{
+    if (!keyLess(lo, hi)){
+      return 0;
+    }
+#ifdef BST_SUBTREE_SIZE
+    return rank(hi) - rank(lo);
+#else
+    std::size_t count = 0;
+    Range r = range(lo, hi);
+    for (iterator it = r.begin(); it != r.end(); ++it){
+      ++count;
+    }
+    return count;
+#endif
+}
+
+/**
+ * @precondition The key exists in the map
+ * Returns the value associated with the key
+ */
+template<class Key, class Value, class Compare, class Alloc>
+Value& BinarySearchTree<Key, Value, Compare, Alloc>::operator[](const Key& key)
+{
+    Node<Key, Value> *curr = internalFind(key);
+    if(curr == NULL) throw std::out_of_range("Invalid key");
+    return curr->getValue();
+}
+template<class Key, class Value, class Compare, class Alloc>
+Value const & BinarySearchTree<Key, Value, Compare, Alloc>::operator[](const Key& key) const
+{
+    Node<Key, Value> *curr = internalFind(key);
+    if(curr == NULL) throw std::out_of_range("Invalid key");
+    return curr->getValue();
+}
+
+/**
+* An insert method to insert into a Binary Search Tree.
+* The tree will not remain balanced when inserting.
+* Recall: If key is already in the tree, you should 
+* overwrite the current value with the updated value.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::insert(const std::pair<const Key, Value> &keyValuePair)
+{
+    bool inserted;
+    internalInsert(keyValuePair.first, keyValuePair.second, true, inserted);
+}
+
+/**
+* insert() for a temporary pair: the value is moved into the tree. The
+* key is const inside the pair, so it is still copied once.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::insert(std::pair<const Key, Value>&& keyValuePair)
+{
+    bool inserted;
+    internalInsert(Key(keyValuePair.first), std::move(keyValuePair.second), true, inserted);
+}
+
+/**
+* insert() for any other pair that converts to a key and value, such as
+* the result of std::make_pair. A temporary pair has both its key and
+* value moved into the tree.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+template<typename Pair>
+typename std::enable_if<std::is_constructible<std::pair<Key, Value>, Pair&&>::value &&
+                        !std::is_same<typename std::decay<Pair>::type, std::pair<const Key, Value> >::value>::type
+BinarySearchTree<Key, Value, Compare, Alloc>::insert(Pair&& keyValuePair)
+{
+    std::pair<Key, Value> item(std::forward<Pair>(keyValuePair));
+    bool inserted;
+    internalInsert(std::move(item.first), std::move(item.second), true, inserted);
+}
+
+/**
+* Inserts the key with the given value, or overwrites the value if the
+* key already exists. Returns an iterator to the item and true if a new
+* node was created.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+std::pair<typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator, bool>
+BinarySearchTree<Key, Value, Compare, Alloc>::insert_or_assign(const Key& key, const Value& value)
+{
+    bool inserted;
+    Node<Key, Value>* n = internalInsert(key, value, true, inserted);
+    return std::make_pair(iterator(n, this), inserted);
+}
+
+/**
+* insert_or_assign() that moves the key and value into the tree.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+std::pair<typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator, bool>
+BinarySearchTree<Key, Value, Compare, Alloc>::insert_or_assign(Key&& key, Value&& value)
+{
+    bool inserted;
+    Node<Key, Value>* n = internalInsert(std::move(key), std::move(value), true, inserted);
+    return std::make_pair(iterator(n, this), inserted);
+}
+
+/**
+* Inserts the key with the given value only if the key does not exist yet.
+* Returns an iterator to the (new or existing) item and true if a new
+* node was created.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+std::pair<typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator, bool>
+BinarySearchTree<Key, Value, Compare, Alloc>::try_emplace(const Key& key, const Value& value)
+{
+    bool inserted;
+    Node<Key, Value>* n = internalInsert(key, value, false, inserted);
+    return std::make_pair(iterator(n, this), inserted);
+}
+
+/**
+* try_emplace() that moves the key and value into a new node. If the key
+* already exists, neither argument is moved from.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+std::pair<typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator, bool>
+BinarySearchTree<Key, Value, Compare, Alloc>::try_emplace(Key&& key, Value&& value)
+{
+    bool inserted;
+    Node<Key, Value>* n = internalInsert(std::move(key), std::move(value), false, inserted);
+    return std::make_pair(iterator(n, this), inserted);
+}
+
+/**
+* Builds the key/value pair from args, as std::pair<Key, Value>(args...)
+* would, and moves it into a new node unless the key already exists.
+* Returns an iterator to the (new or existing) item and true if a new
+* node was created.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+template<typename... Args>
+std::pair<typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator, bool>
+BinarySearchTree<Key, Value, Compare, Alloc>::emplace(Args&&... args)
+{
+    std::pair<Key, Value> item(std::forward<Args>(args)...);
+    bool inserted;
+    Node<Key, Value>* n = internalInsert(std::move(item.first), std::move(item.second), false, inserted);
+    return std::make_pair(iterator(n, this), inserted);
+}
+
+/**
+* Insert hook shared by insert, insert_or_assign and try_emplace, for a
+* key and value that must be copied. See insertItem.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare, Alloc>::internalInsert(
+    const Key& key, const Value& value, bool overwrite, bool& inserted)
+{
+    return insertItem(key, value, overwrite, inserted);
+}
+
+/**
+* Insert hook for a key and value that may be moved from.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare, Alloc>::internalInsert(
+    Key&& key, Value&& value, bool overwrite, bool& inserted)
+{
+    return insertItem(std::move(key), std::move(value), overwrite, inserted);
+}
+
+/**
+* Helper that does a single descent from the root: either finds the
+* existing node for key (overwriting its value when overwrite is true)
+* or links a new node where the search fell off the tree. Sets inserted
+* and returns the node holding key. key and value are forwarded, and
+* only used up when they are stored.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+template<typename K, typename V>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare, Alloc>::insertItem(
+    K&& key, V&& value, bool overwrite, bool& inserted)
+{
+    Node<Key, Value>* r = root_;
+    Node<Key, Value>* p = NULL;
+    bool goLeft = false;
+    while (r != NULL){
+      count(OperationCounts::NODES_VISITED);
+      p = r;
+      int c = compareKeys(key, r->getKey());
+      if (c < 0){
+        goLeft = true;
+        r = r->getLeft();
+      }else if (c > 0){
+        goLeft = false;
+        r = r->getRight();
+      }else{
+        if (overwrite){
+          r->setValue(std::forward<V>(value));
+        }
+        inserted = false;
+        return r;
+      }
+    }
+    Node<Key, Value>* n = createNode<Node<Key, Value> >(std::forward<K>(key), std::forward<V>(value), p);
+    if (p == NULL){
+      root_ = n;
+    }else if (goLeft){
+      p->setLeft(n);
+    }else{
+      p->setRight(n);
+    }
+    adjustPathSizes(p, 1);
+    inserted = true;
+    return n;
+}
+
+
+/**
+* A remove method to remove a specific key from a Binary Search Tree.
+* Recall: The writeup specifies that if a node has 2 children you
+* should swap with the predecessor and then remove.
+*/
+
+template<class Key, class Value, class Compare, class Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::remove(const Key& key) {
+    Node<Key, Value>* nodeToRemove = internalFind(key);
+    if (nodeToRemove == nullptr) {
+        return;
+    }
+    if (nodeToRemove->getLeft() != nullptr && nodeToRemove->getRight() != nullptr) {
+        Node<Key, Value>* pred = predecessor(nodeToRemove);
+        nodeSwap(nodeToRemove, pred);
+    }
+    Node<Key, Value>* child = (nodeToRemove->getLeft() != nullptr) ? nodeToRemove->getLeft() : nodeToRemove->getRight();
+    if (child == nullptr) {
+        if (nodeToRemove == root_) {
+            root_ = nullptr;
+        } else {
+            Node<Key, Value>* parent = nodeToRemove->getParent();
+            if (parent->getLeft() == nodeToRemove) {
+                parent->setLeft(nullptr);
+            } else {
+                parent->setRight(nullptr);
+            }
+        }
+    } else {
+        if (nodeToRemove == root_) {
+            root_ = child;
+            root_->setParent(nullptr); 
+        } else {
+            Node<Key, Value>* parent = nodeToRemove->getParent();
+            if (parent->getLeft() == nodeToRemove) {
+                parent->setLeft(child);
+            } else {
+                parent->setRight(child);
+            }
+            child->setParent(parent);
+        }
+    }
+    adjustPathSizes(nodeToRemove->getParent(), -1);
+    destroyNode(nodeToRemove);
+}
+
+
+
+template<class Key, class Value, class Compare, class Alloc>
+Node<Key, Value>*
+BinarySearchTree<Key, Value, Compare, Alloc>::predecessor(Node<Key, Value>* current)
+{
+    // TODO
+    if (current->getLeft() != NULL){
+      Node<Key, Value>* temp = current->getLeft();
+      while(temp->getRight() != NULL){
+        temp = temp->getRight();
+      }
+      return temp;
+    }else{
+      Node<Key, Value>* p = current->getParent();
+      while((p != NULL) && (current == p->getLeft())){
+        current = p;
+        p = p->getParent();
+      }
+      return p;
+    }
+
+}
+
+
+/**
+* Returns the next node in key order, or NULL after the largest.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+Node<Key, Value>*
+BinarySearchTree<Key, Value, Compare, Alloc>::successor(Node<Key, Value>* current)
+{
+    if (current->getRight() != NULL){
+      Node<Key, Value>* temp = current->getRight();
+      while(temp->getLeft() != NULL){
+        temp = temp->getLeft();
+      }
+      return temp;
+    }else{
+      Node<Key, Value>* p = current->getParent();
+      while((p != NULL) && (current == p->getRight())){
+        current = p;
+        p = p->getParent();
+      }
+      return p;
+    }
+}
+
+
+/**
+* Returns the number of keys in the tree that are less than key.
+* O(log n) with BST_SUBTREE_SIZE, otherwise an in-order walk.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+std::size_t BinarySearchTree<Key, Value, Compare, Alloc>::rank(const Key& key) const
+{
+#ifdef BST_SUBTREE_SIZE
+    std::size_t r = 0;
+    Node<Key, Value>* n = root_;
+    while (n != NULL){
+      count(OperationCounts::NODES_VISITED);
+      int c = compareKeys(key, n->getKey());
+      if (c < 0){
+        n = n->getLeft();
+      }else if (c > 0){
+        r += subtreeSize(n->getLeft()) + 1;
+        n = n->getRight();
+      }else{
+        return r + subtreeSize(n->getLeft());
+      }
+    }
+    return r;
+#else
+    std::size_t r = 0;
+    for (Node<Key, Value>* n = getSmallestNode(); n != NULL && keyLess(n->getKey(), key); n = successor(n)){
+      ++r;
+    }
+    return r;
+#endif
+}
+
+/**
+* Returns an iterator to the k-th smallest item (counting from 0), or
+* end() if k >= size(). O(log n) with BST_SUBTREE_SIZE, otherwise an
+* in-order walk.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::select(std::size_t k) const
+{
+#ifdef BST_SUBTREE_SIZE
+    Node<Key, Value>* n = root_;
+    while (n != NULL){
+      count(OperationCounts::NODES_VISITED);
+      std::size_t leftSize = subtreeSize(n->getLeft());
+      if (k < leftSize){
+        n = n->getLeft();
+      }else if (k == leftSize){
+        break;
+      }else{
+        k -= leftSize + 1;
+        n = n->getRight();
+      }
+    }
+    return iterator(n, this);
+#else
+    Node<Key, Value>* n = getSmallestNode();
+    while (n != NULL && k > 0){
+      n = successor(n);
+      --k;
+    }
+    return iterator(n, this);
+#endif
+}
+
+/**
+* Number of nodes in the subtree rooted at n (0 for NULL).
+* Without BST_SUBTREE_SIZE this is only meaningful for NULL.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+std::size_t BinarySearchTree<Key, Value, Compare, Alloc>::subtreeSize(Node<Key, Value>* n)
+{
+#ifdef BST_SUBTREE_SIZE
+    return (n == NULL) ? 0 : n->getSize();
+#else
+    return (n == NULL) ? 0 : 1;
+#endif
+}
+
+/**
+* Recomputes n's subtree size from its children, e.g. after a rotation.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::resetSize(Node<Key, Value>* n)
+{
+#ifdef BST_SUBTREE_SIZE
+    n->setSize(subtreeSize(n->getLeft()) + subtreeSize(n->getRight()) + 1);
+#else
+    (void)n;
+#endif
+}
+
+/**
+* Adds delta to the subtree size of n and every ancestor of n, after a
+* node below n was linked in or unlinked.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::adjustPathSizes(Node<Key, Value>* n, int delta)
+{
+#ifdef BST_SUBTREE_SIZE
+    for (; n != NULL; n = n->getParent()){
+      n->setSize(n->getSize() + delta);
+    }
+#else
+    (void)n;
+    (void)delta;
+#endif
+}
+
+/**
+* Called when nodes were moved in or out wholesale and the count is no
+* longer known. Free with subtree sizes; otherwise the next size() walks
+* the tree.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::invalidateCount()
+{
+#ifdef BST_SUBTREE_SIZE
+    nodeCount_ = subtreeSize(root_);
+#else
+    countStale_ = true;
+#endif
+}
+
+/**
+* True if key a orders before key b. Either may also be a lookup key
+* (see IsLookupKey).
+*/
+template<class Key, class Value, class Compare, class Alloc>
+template<typename A, typename B>
+bool BinarySearchTree<Key, Value, Compare, Alloc>::keyLess(const A& a, const B& b) const
+{
+    count(OperationCounts::COMPARISONS);
+    return KeyOrder<Key, Compare>::less(comp_, a, b);
+}
+
+/**
+* Negative, zero or positive as key a orders before, the same as or
+* after key b, in one comparison where the key type allows it.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+template<typename A, typename B>
+int BinarySearchTree<Key, Value, Compare, Alloc>::compareKeys(const A& a, const B& b) const
+{
+    count(OperationCounts::COMPARISONS);
+    return KeyOrder<Key, Compare>::compare(comp_, a, b);
+}
+
+/**
+* Adds by to the counter for kind. Compiled out unless BST_STATS is
+* defined, so an uninstrumented tree pays nothing.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::count(OperationCounts::Kind kind, std::size_t by) const
+{
+#ifdef BST_STATS
+    counter_.add(kind, by);
+#else
+    (void)kind;
+    (void)by;
+#endif
+}
+
+/**
+* Starts loading the cache line holding n's key, so that it has arrived
+* by the time a descent reaches n. Prefetching NULL is harmless.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::prefetchNode(const Node<Key, Value>* n)
+{
+#if defined(__GNUC__)
+    __builtin_prefetch(n);
+#else
+    (void)n;
+#endif
+}
+
+/**
+* A method to remove all contents of the tree and
+* reset the values in the tree for use again.
+* With a pooling allocator and trivially destructible keys/values the
+* nodes are not visited at all; the allocator frees its slabs at once.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::clear()
+{
+    if (!(Alloc::releasesAll &&
+          std::is_trivially_destructible<Key>::value &&
+          std::is_trivially_destructible<Value>::value)){
+      clearHelper(root_);
+    }
+#ifdef BST_STATS
+    else{
+      count(OperationCounts::DEALLOCATIONS, size());
+    }
+#endif
+    root_ = nullptr;
+    nodeCount_ = 0;
+    countStale_ = false;
+    alloc_.release();
+}
+
+/**
+* Destroys the subtree at n in one pass with no stack: while the current
+* node has a left child it is rotated right, so the subtree unrolls into
+* a right spine that is freed as it is walked. Each rotation moves one
+* node off the left side for good, so the work stays linear even for a
+* degenerate tree.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::clearHelper(Node<Key, Value>* n)
+{
+  while (n != nullptr){
+    Node<Key, Value>* left = n->getLeft();
+    if (left != nullptr){
+      n->setLeft(left->getRight());
+      left->setRight(n);
+      n = left;
+    }else{
+      Node<Key, Value>* right = n->getRight();
+      destroyNode(n);
+      n = right;
+    }
+  }
+}
+
+/**
+* Constructs a node of the given type in memory from alloc_.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+template<typename NodeType, typename K, typename V>
+NodeType* BinarySearchTree<Key, Value, Compare, Alloc>::createNode(K&& key, V&& value, NodeType* parent)
+{
+    NodeType* n = constructNode(alloc_, std::forward<K>(key), std::forward<V>(value), parent);
+    ++nodeCount_;
+    count(OperationCounts::ALLOCATIONS);
+    return n;
+}
+
+/**
+* Constructs a node of the given type in memory from alloc, without
+* counting it. Used directly by the bulk builds, which may run on
+* several threads with an allocator each and set the count at the end.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+template<typename NodeType, typename K, typename V>
+NodeType* BinarySearchTree<Key, Value, Compare, Alloc>::constructNode(
+    Alloc& alloc, K&& key, V&& value, NodeType* parent)
+{
+    void* mem = alloc.allocate(sizeof(NodeType));
+    try {
+      return new (mem) NodeType(std::forward<K>(key), std::forward<V>(value), parent);
+    }
+    catch (...) {
+      alloc.deallocate(mem, sizeof(NodeType));
+      throw;
+    }
+}
+
+/**
+* Destroys a node of the given type made by createNode and returns its
+* memory to alloc_.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+template<typename NodeType>
+void BinarySearchTree<Key, Value, Compare, Alloc>::destroyNodeAs(NodeType* n)
+{
+    n->~NodeType();
+    alloc_.deallocate(n, sizeof(NodeType));
+    --nodeCount_;
+    count(OperationCounts::DEALLOCATIONS);
+}
+
+/**
+* Destroys a node made by createNode. Trees that allocate a derived node
+* type override this, since Node has no virtual destructor.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::destroyNode(Node<Key, Value>* n)
+{
+    destroyNodeAs(n);
+}
+
+/**
+* Replaces the contents of the tree with the key/value pairs in
+* [first, last). Input sorted by strictly increasing key is built
+* bottom-up in linear time; anything else is sorted first, and for
+* repeated keys the last value wins, as with repeated insert() calls.
+* The result is perfectly balanced.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+template<typename InputIt>
+void BinarySearchTree<Key, Value, Compare, Alloc>::assign(InputIt first, InputIt last)
+{
+    assignRange(first, last, 1, typename std::iterator_traits<InputIt>::iterator_category());
+}
+
+/**
+* assign() with the node building split across threads (all hardware
+* threads when threads is 0). The top levels of the tree are cut at the
+* middle item as usual and each half is handed to its own thread until
+* every thread has a subtree; each thread allocates from its own
+* allocator, so they never contend. Sorting unsorted input stays serial.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+template<typename InputIt>
+void BinarySearchTree<Key, Value, Compare, Alloc>::assignParallel(InputIt first, InputIt last, unsigned threads)
+{
+    assignRange(first, last, threadCount(threads), typename std::iterator_traits<InputIt>::iterator_category());
+}
+
+/**
+* assign() for random access input: a range that is already sorted is
+* built straight from the iterators without copying it.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+template<typename RandomIt>
+void BinarySearchTree<Key, Value, Compare, Alloc>::assignRange(
+    RandomIt first, RandomIt last, unsigned threads, std::random_access_iterator_tag)
+{
+    std::size_t count = (std::size_t)(last - first);
+    bool sorted = true;
+    for (std::size_t i = 1; i < count && sorted; ++i){
+      sorted = keyLess(first[i - 1].first, first[i].first);
+    }
+    if (!sorted){
+      assignRange(first, last, threads, std::input_iterator_tag());
+      return;
+    }
+    clear();
+    buildTree(first, count, threads);
+}
+
+/**
+* assign() for any other input: copies the items, then sorts them and
+* drops repeated keys if needed.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+template<typename InputIt>
+void BinarySearchTree<Key, Value, Compare, Alloc>::assignRange(
+    InputIt first, InputIt last, unsigned threads, std::input_iterator_tag)
+{
+    std::vector<std::pair<Key, Value> > items(first, last);
+    sortUniqueItems(items);
+    clear();
+    buildTree(items.begin(), items.size(), threads);
+}
+
+/**
+* Sorts items by key unless they already are, keeping only the last
+* value given for each key.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::sortUniqueItems(std::vector<std::pair<Key, Value> >& items) const
+{
+    bool sorted = true;
+    for (std::size_t i = 1; i < items.size() && sorted; ++i){
+      sorted = keyLess(items[i - 1].first, items[i].first);
+    }
+    if (sorted){
+      return;
+    }
+    std::stable_sort(items.begin(), items.end(),
+        [this](const std::pair<Key, Value>& a, const std::pair<Key, Value>& b)
+        { return keyLess(a.first, b.first); });
+    std::size_t out = 0;
+    for (std::size_t i = 0; i < items.size(); ++i){
+      if (out > 0 && !keyLess(items[out - 1].first, items[i].first)){
+        items[out - 1].second = items[i].second;
+      }else{
+        if (out != i){
+          items[out] = items[i];
+        }
+        ++out;
+      }
+    }
+    items.erase(items.begin() + out, items.end());
+}
+
+/**
+* Inserts (or overwrites) every key/value pair in [first, last).
+* The batch is sorted first. Small batches are applied key by key in
+* sorted order, which keeps consecutive descents on the same cached
+* path; large ones are merged with an in-order walk of the tree and the
+* result is rebuilt balanced in a single linear pass.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+template<typename InputIt>
+void BinarySearchTree<Key, Value, Compare, Alloc>::insertBatch(InputIt first, InputIt last)
+{
+    std::vector<std::pair<Key, Value> > batch(first, last);
+    sortUniqueItems(batch);
+    if (!preferRebuild(batch.size())){
+      bool inserted;
+      for (std::size_t i = 0; i < batch.size(); ++i){
+        internalInsert(std::move(batch[i].first), std::move(batch[i].second), true, inserted);
+      }
+      return;
+    }
+    std::vector<std::pair<Key, Value> > merged;
+    merged.reserve(size() + batch.size());
+    std::size_t b = 0;
+    for (Node<Key, Value>* n = getSmallestNode(); n != NULL; n = successor(n)){
+      while (b < batch.size() && keyLess(batch[b].first, n->getKey())){
+        merged.push_back(std::move(batch[b++]));
+      }
+      if (b < batch.size() && !keyLess(n->getKey(), batch[b].first)){
+        merged.push_back(std::move(batch[b++]));
+      }else{
+        merged.push_back(std::pair<Key, Value>(n->getKey(), std::move(n->getValue())));
+      }
+    }
+    while (b < batch.size()){
+      merged.push_back(std::move(batch[b++]));
+    }
+    clear();
+    buildTree(merged.begin(), merged.size(), 1);
+}
+
+/**
+* Removes every key in [first, last) that is in the tree. Uses the same
+* strategy as insertBatch: per-key removal for small batches, otherwise
+* one merge walk that keeps the surviving items and a balanced rebuild.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+template<typename InputIt>
+void BinarySearchTree<Key, Value, Compare, Alloc>::removeBatch(InputIt first, InputIt last)
+{
+    std::vector<Key> batch(first, last);
+    std::sort(batch.begin(), batch.end(), [this](const Key& a, const Key& b)
+      { return keyLess(a, b); });
+    if (!preferRebuild(batch.size())){
+      for (std::size_t i = 0; i < batch.size(); ++i){
+        remove(batch[i]);
+      }
+      return;
+    }
+    std::vector<std::pair<Key, Value> > kept;
+    std::size_t b = 0;
+    for (Node<Key, Value>* n = getSmallestNode(); n != NULL; n = successor(n)){
+      while (b < batch.size() && keyLess(batch[b], n->getKey())){
+        ++b;
+      }
+      if (b == batch.size() || keyLess(n->getKey(), batch[b])){
+        kept.push_back(std::pair<Key, Value>(n->getKey(), std::move(n->getValue())));
+      }
+    }
+    clear();
+    buildTree(kept.begin(), kept.size(), 1);
+}
+
+/**
+* True when a batch is big enough that one linear merge and rebuild is
+* cheaper than a descent per key. A rebuild touches every node but each
+* step is a sequential copy, so it wins once batch * log2(size) reaches
+* about four times the size.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+bool BinarySearchTree<Key, Value, Compare, Alloc>::preferRebuild(std::size_t batchSize) const
+{
+    std::size_t count = size();
+    std::size_t log2Size = 1;
+    for (std::size_t n = count; n > 1; n /= 2){
+      ++log2Size;
+    }
+    return batchSize * log2Size >= 4 * count;
+}
+
+/**
+* Makes the (empty) tree hold items[0, count), which are sorted by
+* strictly increasing key, using up to threads threads.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+template<typename RandomIt>
+void BinarySearchTree<Key, Value, Compare, Alloc>::buildTree(RandomIt items, std::size_t count, unsigned threads)
+{
+    root_ = buildSubtreeParallel(items, 0, count, NULL, alloc_, threads);
+    nodeCount_ = count;
+    this->count(OperationCounts::ALLOCATIONS, count);
+}
+
+/**
+* Builds a perfectly balanced subtree from items[lo, hi) with the
+* middle item as its root and returns the root.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+template<typename RandomIt>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare, Alloc>::buildSubtree(
+    RandomIt items, std::size_t lo, std::size_t hi, Node<Key, Value>* parent, Alloc& alloc) const
+{
+    if (lo >= hi){
+      return NULL;
+    }
+    std::size_t mid = lo + (hi - lo) / 2;
+    int8_t balance = (int8_t)(builtHeight(hi - mid - 1) - builtHeight(mid - lo));
+    Node<Key, Value>* n = createBuiltNode(alloc, items[mid].first, items[mid].second, parent, balance,
+                                          builtHeight(hi - lo));
+    n->setLeft(buildSubtree(items, lo, mid, n, alloc));
+    n->setRight(buildSubtree(items, mid + 1, hi, n, alloc));
+    resetSize(n);
+    return n;
+}
+
+/**
+* buildSubtree spread over threads threads: the right half goes to a new
+* thread with an allocator of its own, which alloc adopts once the
+* thread is done (unused slab space included), and the left half stays
+* on this one. The halves
+* are the same size, so splitting the threads evenly keeps them busy.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+template<typename RandomIt>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare, Alloc>::buildSubtreeParallel(
+    RandomIt items, std::size_t lo, std::size_t hi, Node<Key, Value>* parent, Alloc& alloc, unsigned threads) const
+{
+    if (threads <= 1 || hi - lo < PARALLEL_MIN_ITEMS){
+      return buildSubtree(items, lo, hi, parent, alloc);
+    }
+    std::size_t mid = lo + (hi - lo) / 2;
+    int8_t balance = (int8_t)(builtHeight(hi - mid - 1) - builtHeight(mid - lo));
+    Node<Key, Value>* n = createBuiltNode(alloc, items[mid].first, items[mid].second, parent, balance,
+                                          builtHeight(hi - lo));
+    unsigned rightThreads = threads / 2;
+    Alloc rightAlloc;
+    Node<Key, Value>* right = NULL;
+    std::exception_ptr rightError;
+    std::thread worker([&]() {
+      try {
+        right = buildSubtreeParallel(items, mid + 1, hi, n, rightAlloc, rightThreads);
+      }
+      catch (...) {
+        rightError = std::current_exception();
+      }
+    });
+    Node<Key, Value>* left = NULL;
+    try {
+      left = buildSubtreeParallel(items, lo, mid, n, alloc, threads - rightThreads);
+    }
+    catch (...) {
+      worker.join();
+      alloc.adopt(rightAlloc);
+      throw;
+    }
+    worker.join();
+    alloc.adopt(rightAlloc);
+    if (rightError){
+      std::rethrow_exception(rightError);
+    }
+    n->setLeft(left);
+    n->setRight(right);
+    resetSize(n);
+    return n;
+}
+
+/**
+* The number of threads to use for a request of threads, where 0 means
+* one per hardware thread.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+unsigned BinarySearchTree<Key, Value, Compare, Alloc>::threadCount(unsigned threads)
+{
+    if (threads == 0){
+      threads = std::thread::hardware_concurrency();
+    }
+    return (threads == 0) ? 1 : threads;
+}
+
+/**
+* Height of a subtree of count nodes made by buildSubtree, which is
+* floor(log2(count)) + 1 since it splits at the middle.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+int BinarySearchTree<Key, Value, Compare, Alloc>::builtHeight(std::size_t count)
+{
+    int height = 0;
+    while (count > 0){
+      ++height;
+      count /= 2;
+    }
+    return height;
+}
+
+/**
+* Creates an uncounted node in alloc for buildSubtree. balance is the
+* height of the right subtree minus the left one and height that of the
+* node's own subtree (1 for a leaf), for trees whose nodes derive
+* something from them. May be called from several threads at once.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare, Alloc>::createBuiltNode(
+    Alloc& alloc, const Key& key, const Value& value, Node<Key, Value>* parent, int8_t, int) const
+{
+    return constructNode<Node<Key, Value> >(alloc, key, value, parent);
+}
+
+/**
+* A helper function to find the smallest node in the tree.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+Node<Key, Value>*
+BinarySearchTree<Key, Value, Compare, Alloc>::getSmallestNode() const
+{
+    // TODO
+    if (root_ == NULL){
+      return NULL;
+    }
+    return getSmallestNodeHelper(root_);
+}
+
+/**
+* A helper function to find the largest node in the tree.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+Node<Key, Value>*
+BinarySearchTree<Key, Value, Compare, Alloc>::getLargestNode() const
+{
+    Node<Key, Value>* n = root_;
+    if (n == NULL){
+      return NULL;
+    }
+    while (n->getRight() != NULL){
+      n = n->getRight();
+    }
+    return n;
+}
+
+template<typename Key, typename Value, typename Compare, typename Alloc>
+Node<Key, Value>* 
+BinarySearchTree<Key, Value, Compare, Alloc>::getSmallestNodeHelper(Node<Key, Value>* n) const
+{
+  if (n == NULL){
+    return NULL;
   }
-  int l = isBalancedHelper(n->getLeft());
-  if (l == -1){
-    return -1;
+  while (n->getLeft() != NULL){
+    n = n->getLeft();
   }
-  int r = (isBalancedHelper(n->getRight()));
-  if (r == -1){
-    return -1;
+  return n;
+}
+
+/**
+* Helper function to find a node with given key, k and
+* return a pointer to it or NULL if no item with that key
+* exists
+*
+* Both children are prefetched before the key comparison, so the next
+* node is already on its way whichever side the search takes, and the
+* side is picked with a select rather than a branch: on random keys that
+* branch would be mispredicted about half the time. Only the exit on an
+* equal key branches, and it is taken once per search.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+template<typename K>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare, Alloc>::internalFind(const K& key) const
+{
+    // TODO
+    Node<Key, Value>* temp = root_;
+    while (temp != NULL){
+      count(OperationCounts::NODES_VISITED);
+      Node<Key, Value>* left = temp->getLeft();
+      Node<Key, Value>* right = temp->getRight();
+      prefetchNode(left);
+      prefetchNode(right);
+      int c = compareKeys(key, temp->getKey());
+      if (c == 0){
+        return temp;
+      }
+      temp = (c < 0) ? left : right;
+    }
+    return NULL;
+    
+}
+
+/**
+ * Return true iff the BST is balanced.
+ */
+template<typename Key, typename Value, typename Compare, typename Alloc>
+bool BinarySearchTree<Key, Value, Compare, Alloc>::isBalanced() const
+{
+    // TODO
+  return isBalancedHelper(root_);
+}
+
+template<typename Key, typename Value, typename Compare, typename Alloc>
+bool BinarySearchTree<Key, Value, Compare, Alloc>::isBalancedHelper(Node<Key, Value>* n) const
+{
+  if (n == NULL){
+    return true;
   }
-  if ((l - r > 1) || (l - r < -1)){
-    return -1;
+  // A tree that is balanced everywhere is no taller than an AVL tree of
+  // the same size (about 1.44 log2 n), so a deeper path answers no
+  // early, and the per-depth storage below stays O(log n).
+  std::size_t maxDepth = 2;
+  for (std::size_t count = size() + 2; count > 1; count /= 2){
+    maxDepth += 3;
   }
-  if (l > r){
-    return l + 1;
-  }else{
-    return r + 1;
+  maxDepth /= 2;
+  // heights of the finished left and right subtrees of the node at each depth
+  std::vector<int> leftHeight;
+  std::vector<int> rightHeight;
+  Node<Key, Value>* stop = n->getParent();
+  Node<Key, Value>* prev = stop;
+  std::size_t depth = 0;
+  int finished = 0;
+  // post-order walk that climbs parent pointers instead of recursing
+  while (n != stop){
+    Node<Key, Value>* next;
+    if (prev == n->getParent()){
+      if (depth >= maxDepth){
+        return false;
+      }
+      if (leftHeight.size() <= depth){
+        leftHeight.push_back(0);
+        rightHeight.push_back(0);
+      }
+      leftHeight[depth] = 0;
+      rightHeight[depth] = 0;
+      next = (n->getLeft() != NULL) ? n->getLeft() : n->getRight();
+    }else if (prev == n->getLeft()){
+      leftHeight[depth] = finished;
+      next = n->getRight();
+    }else{
+      rightHeight[depth] = finished;
+      next = NULL;
+    }
+    if (next != NULL){
+      prev = n;
+      n = next;
+      ++depth;
+      continue;
+    }
+    int l = leftHeight[depth];
+    int r = rightHeight[depth];
+    if ((l - r > 1) || (l - r < -1)){
+      return false;
+    }
+    finished = ((l > r) ? l : r) + 1;
+    prev = n;
+    n = n->getParent();
+    --depth;
   }
+  return true;
 }
 
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::nodeSwap( Node<Key,Value>* n1, Node<Key,Value>* n2)
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::nodeSwap( Node<Key,Value>* n1, Node<Key,Value>* n2)
 {
     if((n1 == n2) || (n1 == NULL) || (n2 == NULL) ) {
         return;
     }
+    count(OperationCounts::NODE_SWAPS);
     Node<Key, Value>* n1p = n1->getParent();
     Node<Key, Value>* n1r = n1->getRight();
     Node<Key, Value>* n1lt = n1->getLeft();
@@ -713,6 +2238,13 @@ void BinarySearchTree<Key, Value>::nodeSwap( Node<Key,Value>* n1, Node<Key,Value
     n1->setRight(n2->getRight());
     n2->setRight(temp);
 
+#ifdef BST_SUBTREE_SIZE
+    // sizes belong to the positions, not the items
+    std::size_t tempSize = n1->getSize();
+    n1->setSize(n2->getSize());
+    n2->setSize(tempSize);
+#endif
+
     if( (n1r != NULL && n1r == n2) ) {
         n2->setRight(n1);
         n1->setParent(n2);
@@ -766,6 +2298,45 @@ void BinarySearchTree<Key, Value>::nodeSwap( Node<Key,Value>* n1, Node<Key,Value
 
 }
 
+/**
+* Rotates n up into its parent's place; the parent becomes n's child on
+* the other side and takes over n's inner subtree. Key order, parent
+* pointers and subtree sizes are kept. n must have a parent.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::rotateUp(Node<Key, Value>* n)
+{
+    count(OperationCounts::ROTATIONS);
+    Node<Key, Value>* p = n->getParent();
+    Node<Key, Value>* g = p->getParent();
+    if (p->getLeft() == n){
+      Node<Key, Value>* inner = n->getRight();
+      p->setLeft(inner);
+      if (inner != NULL){
+        inner->setParent(p);
+      }
+      n->setRight(p);
+    }else{
+      Node<Key, Value>* inner = n->getLeft();
+      p->setRight(inner);
+      if (inner != NULL){
+        inner->setParent(p);
+      }
+      n->setLeft(p);
+    }
+    p->setParent(n);
+    n->setParent(g);
+    if (g == NULL){
+      root_ = n;
+    }else if (g->getLeft() == p){
+      g->setLeft(n);
+    }else{
+      g->setRight(n);
+    }
+    resetSize(p);
+    resetSize(n);
+}
+
 /**
  * Lastly, we are providing you with a print function,
    BinarySearchTree::printRoot().
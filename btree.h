@@ -0,0 +1,662 @@
+#ifndef BTREE_H
+#define BTREE_H
+
+#include <iostream>
+#include <exception>
+#include <stdexcept>
+#include <cstdlib>
+#include <cstddef>
+#include <utility>
+
+/**
+* A templated B+ tree with the same insert/remove/find/operator[]/iterator
+* surface as BinarySearchTree. Each node holds up to Fanout keys in one
+* contiguous array, so a lookup costs one cache miss per level instead of
+* one per key comparison, and the search inside a node is a branchless
+* count that the compiler can vectorize. All items live in the leaves,
+* which are linked for iteration.
+*
+* Key and Value must be default constructible and assignable, since
+* node arrays are fully constructed.
+*/
+template <typename Key, typename Value, int Fanout = 32>
+class BTree
+{
+    static_assert(Fanout >= 3, "BTree needs a fanout of at least 3");
+
+protected:
+    struct BNode
+    {
+        explicit BNode(bool leaf);
+        bool leaf_;
+        int count_;                  // number of keys in use
+        Key keys_[Fanout];
+    };
+
+    struct Leaf : public BNode
+    {
+        Leaf();
+        Value values_[Fanout];
+        Leaf* next_;
+        Leaf* prev_;
+    };
+
+    struct Inner : public BNode
+    {
+        Inner();
+        BNode* children_[Fanout + 1];  // children_[i] holds keys below keys_[i]
+    };
+
+public:
+    BTree();
+    BTree(const BTree&) = delete;
+    BTree& operator=(const BTree&) = delete;
+    virtual ~BTree();
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+    bool empty() const;
+    std::size_t size() const;
+
+    /**
+    * An iterator over the items in key order. Keys and values are stored
+    * in separate arrays, so dereferencing yields a pair of references.
+    */
+    class iterator
+    {
+    public:
+        typedef std::pair<const Key&, Value&> reference;
+
+        /**
+        * Lets it->first and it->second work on the pair of references.
+        */
+        class ArrowProxy
+        {
+        public:
+            explicit ArrowProxy(const reference& item) : item_(item) { }
+            const reference* operator->() const { return &item_; }
+        private:
+            reference item_;
+        };
+
+        iterator();
+
+        reference operator*() const;
+        ArrowProxy operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class BTree<Key, Value, Fanout>;
+        iterator(Leaf* leaf, int index);
+        Leaf* leaf_;
+        int index_;
+    };
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    Value& operator[](const Key& key);
+    Value const & operator[](const Key& key) const;
+
+protected:
+    // keys below which a node is refilled before remove() descends into it
+    static const int MIN_KEYS = (Fanout - 1) / 2;
+
+    static int countLess(const BNode* n, const Key& key);
+    static int childIndex(const Inner* n, const Key& key);
+    Leaf* findLeaf(const Key& key) const;
+
+    void splitChild(Inner* parent, int i);
+    void refillChild(Inner* parent, int i);
+    void clearHelper(BNode* n);
+
+    BNode* root_;
+    std::size_t count_;
+};
+
+/*
+  -----------------------------------------
+  Begin implementations for the node structs.
+  -----------------------------------------
+*/
+
+template<typename Key, typename Value, int Fanout>
+BTree<Key, Value, Fanout>::BNode::BNode(bool leaf) :
+    leaf_(leaf),
+    count_(0)
+{
+
+}
+
+template<typename Key, typename Value, int Fanout>
+BTree<Key, Value, Fanout>::Leaf::Leaf() :
+    BNode(true),
+    next_(NULL),
+    prev_(NULL)
+{
+
+}
+
+template<typename Key, typename Value, int Fanout>
+BTree<Key, Value, Fanout>::Inner::Inner() :
+    BNode(false)
+{
+
+}
+
+/*
+  ---------------------------------------
+  End implementations for the node structs.
+  ---------------------------------------
+*/
+
+/*
+--------------------------------------------------------------
+Begin implementations for the BTree::iterator class.
+---------------------------------------------------------------
+*/
+
+/**
+* Explicit constructor that points the iterator at one slot of a leaf.
+*/
+template<typename Key, typename Value, int Fanout>
+BTree<Key, Value, Fanout>::iterator::iterator(Leaf* leaf, int index) :
+    leaf_(leaf),
+    index_(index)
+{
+
+}
+
+/**
+* A default constructor that initializes the iterator to the end.
+*/
+template<typename Key, typename Value, int Fanout>
+BTree<Key, Value, Fanout>::iterator::iterator() :
+    leaf_(NULL),
+    index_(0)
+{
+
+}
+
+/**
+* Provides access to the key and value.
+*/
+template<typename Key, typename Value, int Fanout>
+typename BTree<Key, Value, Fanout>::iterator::reference
+BTree<Key, Value, Fanout>::iterator::operator*() const
+{
+    return reference(leaf_->keys_[index_], leaf_->values_[index_]);
+}
+
+/**
+* Provides member access to the key and value.
+*/
+template<typename Key, typename Value, int Fanout>
+typename BTree<Key, Value, Fanout>::iterator::ArrowProxy
+BTree<Key, Value, Fanout>::iterator::operator->() const
+{
+    return ArrowProxy(**this);
+}
+
+template<typename Key, typename Value, int Fanout>
+bool BTree<Key, Value, Fanout>::iterator::operator==(const iterator& rhs) const
+{
+    return leaf_ == rhs.leaf_ && index_ == rhs.index_;
+}
+
+template<typename Key, typename Value, int Fanout>
+bool BTree<Key, Value, Fanout>::iterator::operator!=(const iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+/**
+* Advances to the next slot, moving to the next leaf when this one is done.
+*/
+template<typename Key, typename Value, int Fanout>
+typename BTree<Key, Value, Fanout>::iterator&
+BTree<Key, Value, Fanout>::iterator::operator++()
+{
+    if (leaf_ == NULL){
+      return *this;
+    }
+    ++index_;
+    if (index_ >= leaf_->count_){
+      leaf_ = leaf_->next_;
+      index_ = 0;
+    }
+    return *this;
+}
+
+/*
+-------------------------------------------------------------
+End implementations for the BTree::iterator class.
+-------------------------------------------------------------
+*/
+
+/*
+-----------------------------------------------------
+Begin implementations for the BTree class.
+-----------------------------------------------------
+*/
+
+template<typename Key, typename Value, int Fanout>
+BTree<Key, Value, Fanout>::BTree() :
+    root_(NULL),
+    count_(0)
+{
+
+}
+
+template<typename Key, typename Value, int Fanout>
+BTree<Key, Value, Fanout>::~BTree()
+{
+    clear();
+}
+
+template<typename Key, typename Value, int Fanout>
+bool BTree<Key, Value, Fanout>::empty() const
+{
+    return count_ == 0;
+}
+
+template<typename Key, typename Value, int Fanout>
+std::size_t BTree<Key, Value, Fanout>::size() const
+{
+    return count_;
+}
+
+/**
+* Number of keys in n that are less than key. Always scans every slot
+* in use without an early exit, so there is nothing to mispredict and
+* the loop vectorizes for arithmetic keys.
+*/
+template<typename Key, typename Value, int Fanout>
+int BTree<Key, Value, Fanout>::countLess(const BNode* n, const Key& key)
+{
+    int less = 0;
+    for (int i = 0; i < n->count_; ++i){
+      less += (n->keys_[i] < key);
+    }
+    return less;
+}
+
+/**
+* The child of n whose range holds key: the number of separators <= key.
+*/
+template<typename Key, typename Value, int Fanout>
+int BTree<Key, Value, Fanout>::childIndex(const Inner* n, const Key& key)
+{
+    int notGreater = 0;
+    for (int i = 0; i < n->count_; ++i){
+      notGreater += !(key < n->keys_[i]);
+    }
+    return notGreater;
+}
+
+/**
+* Returns the leaf whose range holds key, or NULL for an empty tree.
+*/
+template<typename Key, typename Value, int Fanout>
+typename BTree<Key, Value, Fanout>::Leaf*
+BTree<Key, Value, Fanout>::findLeaf(const Key& key) const
+{
+    BNode* n = root_;
+    if (n == NULL){
+      return NULL;
+    }
+    while (!n->leaf_){
+      Inner* inner = static_cast<Inner*>(n);
+      n = inner->children_[childIndex(inner, key)];
+    }
+    return static_cast<Leaf*>(n);
+}
+
+/**
+* Returns an iterator to the smallest item.
+*/
+template<typename Key, typename Value, int Fanout>
+typename BTree<Key, Value, Fanout>::iterator
+BTree<Key, Value, Fanout>::begin() const
+{
+    BNode* n = root_;
+    if (n == NULL || count_ == 0){
+      return end();
+    }
+    while (!n->leaf_){
+      n = static_cast<Inner*>(n)->children_[0];
+    }
+    return iterator(static_cast<Leaf*>(n), 0);
+}
+
+template<typename Key, typename Value, int Fanout>
+typename BTree<Key, Value, Fanout>::iterator
+BTree<Key, Value, Fanout>::end() const
+{
+    return iterator(NULL, 0);
+}
+
+/**
+* Returns an iterator to the item with the given key, or the end
+* iterator if the key does not exist.
+*/
+template<typename Key, typename Value, int Fanout>
+typename BTree<Key, Value, Fanout>::iterator
+BTree<Key, Value, Fanout>::find(const Key& key) const
+{
+    Leaf* leaf = findLeaf(key);
+    if (leaf == NULL){
+      return end();
+    }
+    int i = countLess(leaf, key);
+    if (i < leaf->count_ && !(key < leaf->keys_[i])){
+      return iterator(leaf, i);
+    }
+    return end();
+}
+
+/**
+ * @precondition The key exists in the map
+ * Returns the value associated with the key
+ */
+template<typename Key, typename Value, int Fanout>
+Value& BTree<Key, Value, Fanout>::operator[](const Key& key)
+{
+    iterator it = find(key);
+    if (it == end()) throw std::out_of_range("Invalid key");
+    return it.leaf_->values_[it.index_];
+}
+
+template<typename Key, typename Value, int Fanout>
+Value const & BTree<Key, Value, Fanout>::operator[](const Key& key) const
+{
+    iterator it = find(key);
+    if (it == end()) throw std::out_of_range("Invalid key");
+    return it.leaf_->values_[it.index_];
+}
+
+/**
+* Inserts the pair, overwriting the value if the key already exists.
+* Full nodes are split on the way down, so the leaf reached always has
+* room and nothing has to be fixed on the way back up.
+*/
+template<typename Key, typename Value, int Fanout>
+void BTree<Key, Value, Fanout>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    const Key& key = keyValuePair.first;
+    if (root_ == NULL){
+      root_ = new Leaf();
+    }
+    if (root_->count_ == Fanout){
+      Inner* newRoot = new Inner();
+      newRoot->children_[0] = root_;
+      root_ = newRoot;
+      splitChild(newRoot, 0);
+    }
+    BNode* n = root_;
+    while (!n->leaf_){
+      Inner* inner = static_cast<Inner*>(n);
+      int i = childIndex(inner, key);
+      if (inner->children_[i]->count_ == Fanout){
+        splitChild(inner, i);
+        i = childIndex(inner, key);
+      }
+      n = inner->children_[i];
+    }
+    Leaf* leaf = static_cast<Leaf*>(n);
+    int pos = countLess(leaf, key);
+    if (pos < leaf->count_ && !(key < leaf->keys_[pos])){
+      leaf->values_[pos] = keyValuePair.second;
+      return;
+    }
+    for (int j = leaf->count_; j > pos; --j){
+      leaf->keys_[j] = leaf->keys_[j - 1];
+      leaf->values_[j] = leaf->values_[j - 1];
+    }
+    leaf->keys_[pos] = key;
+    leaf->values_[pos] = keyValuePair.second;
+    ++leaf->count_;
+    ++count_;
+}
+
+/**
+* Splits the full child i of parent in half and adds the separator
+* to parent, which must not be full.
+*/
+template<typename Key, typename Value, int Fanout>
+void BTree<Key, Value, Fanout>::splitChild(Inner* parent, int i)
+{
+    BNode* child = parent->children_[i];
+    int half = child->count_ / 2;
+    Key separator;
+    BNode* right;
+    if (child->leaf_){
+      Leaf* left = static_cast<Leaf*>(child);
+      Leaf* newLeaf = new Leaf();
+      for (int j = half; j < left->count_; ++j){
+        newLeaf->keys_[j - half] = left->keys_[j];
+        newLeaf->values_[j - half] = left->values_[j];
+      }
+      newLeaf->count_ = left->count_ - half;
+      left->count_ = half;
+      newLeaf->next_ = left->next_;
+      newLeaf->prev_ = left;
+      if (left->next_ != NULL){
+        left->next_->prev_ = newLeaf;
+      }
+      left->next_ = newLeaf;
+      separator = newLeaf->keys_[0];
+      right = newLeaf;
+    }else{
+      // the middle key moves up instead of being copied
+      Inner* left = static_cast<Inner*>(child);
+      Inner* newInner = new Inner();
+      for (int j = half + 1; j < left->count_; ++j){
+        newInner->keys_[j - half - 1] = left->keys_[j];
+      }
+      for (int j = half + 1; j <= left->count_; ++j){
+        newInner->children_[j - half - 1] = left->children_[j];
+      }
+      newInner->count_ = left->count_ - half - 1;
+      separator = left->keys_[half];
+      left->count_ = half;
+      right = newInner;
+    }
+    for (int j = parent->count_; j > i; --j){
+      parent->keys_[j] = parent->keys_[j - 1];
+      parent->children_[j + 1] = parent->children_[j];
+    }
+    parent->keys_[i] = separator;
+    parent->children_[i + 1] = right;
+    ++parent->count_;
+}
+
+/**
+* Removes the key if it exists. Children that are at the minimum are
+* refilled from a sibling (or merged with one) before descending, so
+* the leaf can lose a key without anything having to be fixed above it.
+*/
+template<typename Key, typename Value, int Fanout>
+void BTree<Key, Value, Fanout>::remove(const Key& key)
+{
+    if (root_ == NULL){
+      return;
+    }
+    BNode* n = root_;
+    while (!n->leaf_){
+      Inner* inner = static_cast<Inner*>(n);
+      int i = childIndex(inner, key);
+      if (inner->children_[i]->count_ <= MIN_KEYS){
+        refillChild(inner, i);
+        if (inner == root_ && inner->count_ == 0){
+          // the root's last two children were merged
+          root_ = inner->children_[0];
+          delete inner;
+          n = root_;
+          continue;
+        }
+        i = childIndex(inner, key);
+      }
+      n = inner->children_[i];
+    }
+    Leaf* leaf = static_cast<Leaf*>(n);
+    int pos = countLess(leaf, key);
+    if (pos == leaf->count_ || key < leaf->keys_[pos]){
+      return;
+    }
+    for (int j = pos; j + 1 < leaf->count_; ++j){
+      leaf->keys_[j] = leaf->keys_[j + 1];
+      leaf->values_[j] = leaf->values_[j + 1];
+    }
+    --leaf->count_;
+    --count_;
+}
+
+/**
+* Gives child i of parent at least one key more than MIN_KEYS by
+* borrowing from a sibling, or merges it with a sibling when both are
+* at the minimum.
+*/
+template<typename Key, typename Value, int Fanout>
+void BTree<Key, Value, Fanout>::refillChild(Inner* parent, int i)
+{
+    BNode* child = parent->children_[i];
+    BNode* leftSib = (i > 0) ? parent->children_[i - 1] : NULL;
+    BNode* rightSib = (i < parent->count_) ? parent->children_[i + 1] : NULL;
+
+    if (leftSib != NULL && leftSib->count_ > MIN_KEYS){
+      // rotate the left sibling's last item through the parent
+      for (int j = child->count_; j > 0; --j){
+        child->keys_[j] = child->keys_[j - 1];
+      }
+      if (child->leaf_){
+        Leaf* c = static_cast<Leaf*>(child);
+        Leaf* l = static_cast<Leaf*>(leftSib);
+        for (int j = c->count_; j > 0; --j){
+          c->values_[j] = c->values_[j - 1];
+        }
+        c->keys_[0] = l->keys_[l->count_ - 1];
+        c->values_[0] = l->values_[l->count_ - 1];
+        parent->keys_[i - 1] = c->keys_[0];
+      }else{
+        Inner* c = static_cast<Inner*>(child);
+        Inner* l = static_cast<Inner*>(leftSib);
+        for (int j = c->count_ + 1; j > 0; --j){
+          c->children_[j] = c->children_[j - 1];
+        }
+        c->keys_[0] = parent->keys_[i - 1];
+        c->children_[0] = l->children_[l->count_];
+        parent->keys_[i - 1] = l->keys_[l->count_ - 1];
+      }
+      ++child->count_;
+      --leftSib->count_;
+      return;
+    }
+
+    if (rightSib != NULL && rightSib->count_ > MIN_KEYS){
+      // rotate the right sibling's first item through the parent
+      if (child->leaf_){
+        Leaf* c = static_cast<Leaf*>(child);
+        Leaf* r = static_cast<Leaf*>(rightSib);
+        c->keys_[c->count_] = r->keys_[0];
+        c->values_[c->count_] = r->values_[0];
+        for (int j = 0; j + 1 < r->count_; ++j){
+          r->keys_[j] = r->keys_[j + 1];
+          r->values_[j] = r->values_[j + 1];
+        }
+        parent->keys_[i] = r->keys_[0];
+      }else{
+        Inner* c = static_cast<Inner*>(child);
+        Inner* r = static_cast<Inner*>(rightSib);
+        c->keys_[c->count_] = parent->keys_[i];
+        c->children_[c->count_ + 1] = r->children_[0];
+        parent->keys_[i] = r->keys_[0];
+        for (int j = 0; j + 1 < r->count_; ++j){
+          r->keys_[j] = r->keys_[j + 1];
+        }
+        for (int j = 0; j < r->count_; ++j){
+          r->children_[j] = r->children_[j + 1];
+        }
+      }
+      ++child->count_;
+      --rightSib->count_;
+      return;
+    }
+
+    // both neighbours are at the minimum: merge child i and child i + 1
+    int k = (rightSib != NULL) ? i : i - 1;
+    BNode* left = parent->children_[k];
+    BNode* right = parent->children_[k + 1];
+    if (left->leaf_){
+      Leaf* l = static_cast<Leaf*>(left);
+      Leaf* r = static_cast<Leaf*>(right);
+      for (int j = 0; j < r->count_; ++j){
+        l->keys_[l->count_ + j] = r->keys_[j];
+        l->values_[l->count_ + j] = r->values_[j];
+      }
+      l->count_ += r->count_;
+      l->next_ = r->next_;
+      if (r->next_ != NULL){
+        r->next_->prev_ = l;
+      }
+      delete r;
+    }else{
+      Inner* l = static_cast<Inner*>(left);
+      Inner* r = static_cast<Inner*>(right);
+      l->keys_[l->count_] = parent->keys_[k];
+      for (int j = 0; j < r->count_; ++j){
+        l->keys_[l->count_ + 1 + j] = r->keys_[j];
+      }
+      for (int j = 0; j <= r->count_; ++j){
+        l->children_[l->count_ + 1 + j] = r->children_[j];
+      }
+      l->count_ += r->count_ + 1;
+      delete r;
+    }
+    for (int j = k; j + 1 < parent->count_; ++j){
+      parent->keys_[j] = parent->keys_[j + 1];
+      parent->children_[j + 1] = parent->children_[j + 2];
+    }
+    --parent->count_;
+}
+
+/**
+* A method to remove all contents of the tree and
+* reset the values in the tree for use again.
+*/
+template<typename Key, typename Value, int Fanout>
+void BTree<Key, Value, Fanout>::clear()
+{
+    clearHelper(root_);
+    root_ = NULL;
+    count_ = 0;
+}
+
+template<typename Key, typename Value, int Fanout>
+void BTree<Key, Value, Fanout>::clearHelper(BNode* n)
+{
+    if (n == NULL){
+      return;
+    }
+    if (n->leaf_){
+      delete static_cast<Leaf*>(n);
+      return;
+    }
+    Inner* inner = static_cast<Inner*>(n);
+    for (int i = 0; i <= inner->count_; ++i){
+      clearHelper(inner->children_[i]);
+    }
+    delete inner;
+}
+
+/*
+---------------------------------------------------
+End implementations for the BTree class.
+---------------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,680 @@
+#ifndef COMPACT_AVLBST_H
+#define COMPACT_AVLBST_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "key_order.h"
+
+/**
+* An AVL tree laid out for memory rather than for the BinarySearchTree
+* interface. Nodes live in the tree's own arena and link to each other
+* by 32-bit slot index instead of by pointer; there is no parent link
+* (insert and remove keep the search path on the stack instead), and the
+* balance factor sits in the top two bits of the left link. For 8-byte
+* keys and values a node is 24 bytes where an AVLNode is 48.
+*
+* The arena is a list of fixed-size chunks that are never moved, so it
+* grows without the copy and the doubled peak a vector would have, and
+* references to items stay valid until their key is removed. Freed slots
+* are reused before the arena grows. With 30 bits per index a tree holds
+* at most 2^30 - 1 items.
+*
+* The surface is the one BTree has: insert/remove/find/operator[] and a
+* forward iterator. Without parent links the iterator carries its own
+* stack of ancestors, so it is larger than a pointer; iterators are
+* invalidated by any insert or remove.
+*/
+template <typename Key, typename Value, typename Compare = std::less<Key> >
+class CompactAVLTree
+{
+protected:
+    typedef std::uint32_t Index;
+
+    static const int INDEX_BITS = 30;
+    static const Index INDEX_MASK = (Index(1) << INDEX_BITS) - 1;
+    static const Index NIL = 0;                // slot 0 is never handed out
+    static const int CHUNK_BITS = 12;          // 4096 nodes per arena chunk
+    static const Index CHUNK_SIZE = Index(1) << CHUNK_BITS;
+    static const int MAX_HEIGHT = 48;          // 2^30 AVL nodes are at most 43 high
+
+    struct CNode
+    {
+        explicit CNode(const std::pair<const Key, Value>& item);
+        std::pair<const Key, Value> item_;
+        Index left_;                           // low 30 bits: left child; top 2: balance + 1
+        Index right_;
+    };
+
+public:
+    CompactAVLTree();
+    explicit CompactAVLTree(const Compare& comp);
+    CompactAVLTree(const CompactAVLTree&) = delete;
+    CompactAVLTree& operator=(const CompactAVLTree&) = delete;
+    virtual ~CompactAVLTree();
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+    bool empty() const;
+    std::size_t size() const;
+    std::size_t memoryUsage() const;
+
+    /**
+    * An iterator over the items in key order. It holds the current node
+    * and those of its ancestors whose left subtree it is in, which are
+    * the nodes still to visit.
+    */
+    class iterator
+    {
+    public:
+        iterator();
+
+        std::pair<const Key, Value>& operator*() const;
+        std::pair<const Key, Value>* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class CompactAVLTree<Key, Value, Compare>;
+        explicit iterator(const CompactAVLTree* tree);
+        void pushLeftSpine(Index n);
+        const CompactAVLTree* tree_;
+        Index stack_[MAX_HEIGHT];
+        int depth_;
+    };
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    Value& operator[](const Key& key);
+    Value const & operator[](const Key& key) const;
+
+protected:
+    CNode* node(Index i) const;
+    Index left(Index i) const;
+    Index right(Index i) const;
+    int balance(Index i) const;
+    void setLeft(Index i, Index child);
+    void setRight(Index i, Index child);
+    void setBalance(Index i, int balance);
+    void setChild(Index i, bool right, Index child);
+
+    Index allocateNode(const std::pair<const Key, Value>& item);
+    void releaseNode(Index i);
+    Index rebalance(Index n, int balance, bool& shorter);
+    void replaceChild(const Index* path, const bool* wentRight, int depth, Index child);
+
+    std::vector<CNode*> chunks_;
+    Index freeList_;                           // head of the freed slots, linked through their storage
+    Index nextSlot_;                           // first slot never handed out
+    Index root_;
+    std::size_t count_;
+    Compare comp_;
+};
+
+/*
+  -----------------------------------------
+  Begin implementations for the CNode struct.
+  -----------------------------------------
+*/
+
+/**
+* A new leaf, with balance 0.
+*/
+template<typename Key, typename Value, typename Compare>
+CompactAVLTree<Key, Value, Compare>::CNode::CNode(const std::pair<const Key, Value>& item) :
+    item_(item),
+    left_(Index(1) << INDEX_BITS),
+    right_(NIL)
+{
+
+}
+
+/*
+  ---------------------------------------
+  End implementations for the CNode struct.
+  ---------------------------------------
+*/
+
+/*
+--------------------------------------------------------------
+Begin implementations for the CompactAVLTree::iterator class.
+---------------------------------------------------------------
+*/
+
+/**
+* A default constructor that initializes the iterator to the end.
+*/
+template<typename Key, typename Value, typename Compare>
+CompactAVLTree<Key, Value, Compare>::iterator::iterator() :
+    tree_(NULL),
+    depth_(0)
+{
+
+}
+
+/**
+* An empty stack in tree, which the caller fills; empty means end().
+*/
+template<typename Key, typename Value, typename Compare>
+CompactAVLTree<Key, Value, Compare>::iterator::iterator(const CompactAVLTree* tree) :
+    tree_(tree),
+    depth_(0)
+{
+
+}
+
+template<typename Key, typename Value, typename Compare>
+std::pair<const Key, Value>&
+CompactAVLTree<Key, Value, Compare>::iterator::operator*() const
+{
+    return tree_->node(stack_[depth_ - 1])->item_;
+}
+
+template<typename Key, typename Value, typename Compare>
+std::pair<const Key, Value>*
+CompactAVLTree<Key, Value, Compare>::iterator::operator->() const
+{
+    return &(tree_->node(stack_[depth_ - 1])->item_);
+}
+
+template<typename Key, typename Value, typename Compare>
+bool CompactAVLTree<Key, Value, Compare>::iterator::operator==(const iterator& rhs) const
+{
+    if (depth_ == 0 || rhs.depth_ == 0){
+      return depth_ == rhs.depth_;
+    }
+    return tree_ == rhs.tree_ && stack_[depth_ - 1] == rhs.stack_[rhs.depth_ - 1];
+}
+
+template<typename Key, typename Value, typename Compare>
+bool CompactAVLTree<Key, Value, Compare>::iterator::operator!=(const iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+/**
+* The next node is the leftmost of the current node's right subtree or,
+* if it has none, the nearest ancestor still on the stack.
+*/
+template<typename Key, typename Value, typename Compare>
+typename CompactAVLTree<Key, Value, Compare>::iterator&
+CompactAVLTree<Key, Value, Compare>::iterator::operator++()
+{
+    if (depth_ == 0){
+      return *this;
+    }
+    Index n = stack_[--depth_];
+    pushLeftSpine(tree_->right(n));
+    return *this;
+}
+
+/**
+* Pushes n and then its left child, its left child, ... down to the
+* smallest key below n.
+*/
+template<typename Key, typename Value, typename Compare>
+void CompactAVLTree<Key, Value, Compare>::iterator::pushLeftSpine(Index n)
+{
+    while (n != NIL){
+      stack_[depth_++] = n;
+      n = tree_->left(n);
+    }
+}
+
+/*
+-------------------------------------------------------------
+End implementations for the CompactAVLTree::iterator class.
+-------------------------------------------------------------
+*/
+
+/*
+-----------------------------------------------------
+Begin implementations for the CompactAVLTree class.
+-----------------------------------------------------
+*/
+
+template<typename Key, typename Value, typename Compare>
+CompactAVLTree<Key, Value, Compare>::CompactAVLTree() :
+    freeList_(NIL),
+    nextSlot_(1),
+    root_(NIL),
+    count_(0),
+    comp_()
+{
+
+}
+
+template<typename Key, typename Value, typename Compare>
+CompactAVLTree<Key, Value, Compare>::CompactAVLTree(const Compare& comp) :
+    freeList_(NIL),
+    nextSlot_(1),
+    root_(NIL),
+    count_(0),
+    comp_(comp)
+{
+
+}
+
+template<typename Key, typename Value, typename Compare>
+CompactAVLTree<Key, Value, Compare>::~CompactAVLTree()
+{
+    clear();
+}
+
+template<typename Key, typename Value, typename Compare>
+bool CompactAVLTree<Key, Value, Compare>::empty() const
+{
+    return count_ == 0;
+}
+
+template<typename Key, typename Value, typename Compare>
+std::size_t CompactAVLTree<Key, Value, Compare>::size() const
+{
+    return count_;
+}
+
+/**
+* Bytes held by the arena and its chunk list, whether or not every slot
+* is in use.
+*/
+template<typename Key, typename Value, typename Compare>
+std::size_t CompactAVLTree<Key, Value, Compare>::memoryUsage() const
+{
+    return chunks_.size() * (CHUNK_SIZE * sizeof(CNode) + sizeof(CNode*));
+}
+
+template<typename Key, typename Value, typename Compare>
+typename CompactAVLTree<Key, Value, Compare>::CNode*
+CompactAVLTree<Key, Value, Compare>::node(Index i) const
+{
+    return chunks_[i >> CHUNK_BITS] + (i & (CHUNK_SIZE - 1));
+}
+
+template<typename Key, typename Value, typename Compare>
+typename CompactAVLTree<Key, Value, Compare>::Index
+CompactAVLTree<Key, Value, Compare>::left(Index i) const
+{
+    return node(i)->left_ & INDEX_MASK;
+}
+
+template<typename Key, typename Value, typename Compare>
+typename CompactAVLTree<Key, Value, Compare>::Index
+CompactAVLTree<Key, Value, Compare>::right(Index i) const
+{
+    return node(i)->right_;
+}
+
+/**
+* Height of the right subtree minus that of the left: -1, 0 or 1.
+*/
+template<typename Key, typename Value, typename Compare>
+int CompactAVLTree<Key, Value, Compare>::balance(Index i) const
+{
+    return int(node(i)->left_ >> INDEX_BITS) - 1;
+}
+
+template<typename Key, typename Value, typename Compare>
+void CompactAVLTree<Key, Value, Compare>::setLeft(Index i, Index child)
+{
+    CNode* n = node(i);
+    n->left_ = (n->left_ & ~INDEX_MASK) | child;
+}
+
+template<typename Key, typename Value, typename Compare>
+void CompactAVLTree<Key, Value, Compare>::setRight(Index i, Index child)
+{
+    node(i)->right_ = child;
+}
+
+template<typename Key, typename Value, typename Compare>
+void CompactAVLTree<Key, Value, Compare>::setBalance(Index i, int balance)
+{
+    CNode* n = node(i);
+    n->left_ = (n->left_ & INDEX_MASK) | (Index(balance + 1) << INDEX_BITS);
+}
+
+template<typename Key, typename Value, typename Compare>
+void CompactAVLTree<Key, Value, Compare>::setChild(Index i, bool right, Index child)
+{
+    if (right){
+      setRight(i, child);
+    }
+    else {
+      setLeft(i, child);
+    }
+}
+
+/**
+* Constructs item in a free slot, reusing a released one if there is
+* any and otherwise taking the next slot, with a new chunk if needed.
+*/
+template<typename Key, typename Value, typename Compare>
+typename CompactAVLTree<Key, Value, Compare>::Index
+CompactAVLTree<Key, Value, Compare>::allocateNode(const std::pair<const Key, Value>& item)
+{
+    Index i = freeList_;
+    if (i != NIL){
+      freeList_ = *static_cast<Index*>(static_cast<void*>(node(i)));
+    }
+    else {
+      if (nextSlot_ > INDEX_MASK){
+        throw std::length_error("CompactAVLTree is full");
+      }
+      if ((nextSlot_ >> CHUNK_BITS) == chunks_.size()){
+        chunks_.push_back(static_cast<CNode*>(::operator new(CHUNK_SIZE * sizeof(CNode))));
+      }
+      i = nextSlot_;
+      new (node(i)) CNode(item);
+      ++nextSlot_;
+      return i;
+    }
+    try {
+      new (node(i)) CNode(item);
+    }
+    catch (...) {
+      new (node(i)) Index(freeList_);
+      freeList_ = i;
+      throw;
+    }
+    return i;
+}
+
+/**
+* Destroys the item in slot i and puts the slot on the free list.
+*/
+template<typename Key, typename Value, typename Compare>
+void CompactAVLTree<Key, Value, Compare>::releaseNode(Index i)
+{
+    node(i)->~CNode();
+    new (node(i)) Index(freeList_);
+    freeList_ = i;
+}
+
+template<typename Key, typename Value, typename Compare>
+void CompactAVLTree<Key, Value, Compare>::clear()
+{
+    if (!std::is_trivially_destructible<CNode>::value && root_ != NIL){
+      std::vector<Index> pending(1, root_);
+      while (!pending.empty()){
+        Index n = pending.back();
+        pending.pop_back();
+        if (left(n) != NIL){
+          pending.push_back(left(n));
+        }
+        if (right(n) != NIL){
+          pending.push_back(right(n));
+        }
+        node(n)->~CNode();
+      }
+    }
+    for (std::size_t c = 0; c < chunks_.size(); ++c){
+      ::operator delete(chunks_[c]);
+    }
+    chunks_.clear();
+    freeList_ = NIL;
+    nextSlot_ = 1;
+    root_ = NIL;
+    count_ = 0;
+}
+
+/**
+* Makes child the child that path[depth] was: the root if depth is 0,
+* otherwise the child of path[depth - 1] on side wentRight[depth - 1].
+*/
+template<typename Key, typename Value, typename Compare>
+void CompactAVLTree<Key, Value, Compare>::replaceChild(const Index* path, const bool* wentRight, int depth, Index child)
+{
+    if (depth == 0){
+      root_ = child;
+    }
+    else {
+      setChild(path[depth - 1], wentRight[depth - 1], child);
+    }
+}
+
+/**
+* Restores the AVL property at n, whose balance has just become +2 or
+* -2 (passed as balance; the stored one is stale). Returns the node now
+* at the top of n's subtree and sets shorter if the subtree is lower
+* than before the rotation, which is always so except when the taller
+* child was itself balanced (possible only after a remove).
+*/
+template<typename Key, typename Value, typename Compare>
+typename CompactAVLTree<Key, Value, Compare>::Index
+CompactAVLTree<Key, Value, Compare>::rebalance(Index n, int balance, bool& shorter)
+{
+    bool rightHeavy = balance > 0;
+    int sign = rightHeavy ? 1 : -1;
+    Index c = rightHeavy ? right(n) : left(n);
+    int childBalance = this->balance(c) * sign;
+    if (childBalance >= 0){
+      // single rotation: c comes up, its inner subtree moves across to n
+      if (rightHeavy){
+        setRight(n, left(c));
+        setLeft(c, n);
+      }
+      else {
+        setLeft(n, right(c));
+        setRight(c, n);
+      }
+      if (childBalance == 0){
+        setBalance(n, sign);
+        setBalance(c, -sign);
+        shorter = false;
+      }
+      else {
+        setBalance(n, 0);
+        setBalance(c, 0);
+        shorter = true;
+      }
+      return c;
+    }
+    // double rotation: c's inner child g comes up over both
+    Index g = rightHeavy ? left(c) : right(c);
+    int grandBalance = this->balance(g) * sign;
+    if (rightHeavy){
+      setLeft(c, right(g));
+      setRight(g, c);
+      setRight(n, left(g));
+      setLeft(g, n);
+    }
+    else {
+      setRight(c, left(g));
+      setLeft(g, c);
+      setLeft(n, right(g));
+      setRight(g, n);
+    }
+    setBalance(n, grandBalance > 0 ? -sign : 0);
+    setBalance(c, grandBalance < 0 ? sign : 0);
+    setBalance(g, 0);
+    shorter = true;
+    return g;
+}
+
+/**
+* Inserts the pair, or overwrites the value if the key is already
+* present. The search path is kept on the stack and retraced for
+* balance updates; at most one (single or double) rotation is needed.
+*/
+template<typename Key, typename Value, typename Compare>
+void CompactAVLTree<Key, Value, Compare>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    Index path[MAX_HEIGHT];
+    bool wentRight[MAX_HEIGHT];
+    int depth = 0;
+    Index n = root_;
+    while (n != NIL){
+      int c = KeyOrder<Key, Compare>::compare(comp_, keyValuePair.first, node(n)->item_.first);
+      if (c == 0){
+        node(n)->item_.second = keyValuePair.second;
+        return;
+      }
+      path[depth] = n;
+      wentRight[depth] = c > 0;
+      ++depth;
+      n = (c > 0) ? right(n) : left(n);
+    }
+    Index fresh = allocateNode(keyValuePair);
+    ++count_;
+    replaceChild(path, wentRight, depth, fresh);
+    for (int d = depth - 1; d >= 0; --d){
+      Index p = path[d];
+      int b = balance(p) + (wentRight[d] ? 1 : -1);
+      if (b == 0){
+        setBalance(p, 0);
+        return;
+      }
+      if (b == 1 || b == -1){
+        setBalance(p, b);
+        continue;
+      }
+      bool shorter;
+      replaceChild(path, wentRight, d, rebalance(p, b, shorter));
+      return;
+    }
+}
+
+/**
+* Removes key if present. A node with two children is replaced by its
+* predecessor, which is relinked into its place (items never move, so
+* outstanding references to other items stay valid), and the path is
+* retraced as far as the subtree heights change.
+*/
+template<typename Key, typename Value, typename Compare>
+void CompactAVLTree<Key, Value, Compare>::remove(const Key& key)
+{
+    Index path[MAX_HEIGHT];
+    bool wentRight[MAX_HEIGHT];
+    int depth = 0;
+    Index n = root_;
+    while (n != NIL){
+      int c = KeyOrder<Key, Compare>::compare(comp_, key, node(n)->item_.first);
+      if (c == 0){
+        break;
+      }
+      path[depth] = n;
+      wentRight[depth] = c > 0;
+      ++depth;
+      n = (c > 0) ? right(n) : left(n);
+    }
+    if (n == NIL){
+      return;
+    }
+    if (left(n) != NIL && right(n) != NIL){
+      int at = depth;
+      path[depth] = n;
+      wentRight[depth] = false;
+      ++depth;
+      Index pred = left(n);
+      while (right(pred) != NIL){
+        path[depth] = pred;
+        wentRight[depth] = true;
+        ++depth;
+        pred = right(pred);
+      }
+      setChild(path[depth - 1], wentRight[depth - 1], left(pred));
+      setLeft(pred, left(n));
+      setRight(pred, right(n));
+      setBalance(pred, balance(n));
+      path[at] = pred;
+      replaceChild(path, wentRight, at, pred);
+    }
+    else {
+      replaceChild(path, wentRight, depth, (left(n) != NIL) ? left(n) : right(n));
+    }
+    releaseNode(n);
+    --count_;
+    for (int d = depth - 1; d >= 0; --d){
+      Index p = path[d];
+      int b = balance(p) + (wentRight[d] ? -1 : 1);
+      if (b == 1 || b == -1){
+        setBalance(p, b);
+        return;
+      }
+      if (b == 0){
+        setBalance(p, 0);
+        continue;
+      }
+      bool shorter;
+      replaceChild(path, wentRight, d, rebalance(p, b, shorter));
+      if (!shorter){
+        return;
+      }
+    }
+}
+
+template<typename Key, typename Value, typename Compare>
+typename CompactAVLTree<Key, Value, Compare>::iterator
+CompactAVLTree<Key, Value, Compare>::begin() const
+{
+    iterator it(this);
+    it.pushLeftSpine(root_);
+    return it;
+}
+
+template<typename Key, typename Value, typename Compare>
+typename CompactAVLTree<Key, Value, Compare>::iterator
+CompactAVLTree<Key, Value, Compare>::end() const
+{
+    return iterator(this);
+}
+
+/**
+* Searches for key, stacking the nodes where the search went left, which
+* are the ancestors the iterator still has to visit.
+*/
+template<typename Key, typename Value, typename Compare>
+typename CompactAVLTree<Key, Value, Compare>::iterator
+CompactAVLTree<Key, Value, Compare>::find(const Key& key) const
+{
+    iterator it(this);
+    Index n = root_;
+    while (n != NIL){
+      int c = KeyOrder<Key, Compare>::compare(comp_, key, node(n)->item_.first);
+      if (c == 0){
+        it.stack_[it.depth_++] = n;
+        return it;
+      }
+      if (c < 0){
+        it.stack_[it.depth_++] = n;
+        n = left(n);
+      }
+      else {
+        n = right(n);
+      }
+    }
+    return end();
+}
+
+template<typename Key, typename Value, typename Compare>
+Value& CompactAVLTree<Key, Value, Compare>::operator[](const Key& key)
+{
+    iterator it = find(key);
+    if (it == end()) throw std::out_of_range("Invalid key");
+    return it->second;
+}
+
+template<typename Key, typename Value, typename Compare>
+Value const & CompactAVLTree<Key, Value, Compare>::operator[](const Key& key) const
+{
+    iterator it = find(key);
+    if (it == end()) throw std::out_of_range("Invalid key");
+    return it->second;
+}
+
+/*
+-----------------------------------------------------
+End implementations for the CompactAVLTree class.
+-----------------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,280 @@
+#ifndef CONCURRENT_AVLBST_H
+#define CONCURRENT_AVLBST_H
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include "avlbst.h"
+
+/**
+* An AVLTree that many threads can share without an outside lock.
+*
+* Writers (insert, remove, clear) are serialized by a mutex. Readers
+* never touch a shared cache line: each thread registers on its own
+* padded counter slot, so concurrent finds and scans scale with the
+* number of cores instead of bouncing one lock word between them (a
+* "big reader" lock). A writer raises a flag, waits for the reader slots
+* to drain and then has the tree to itself; readers that arrive while
+* the flag is up wait for it to drop. Lookups return copies, since an
+* iterator could not stay valid once the read lock is released.
+*/
+template <class Key, class Value, class Compare = std::less<Key>, class Alloc = NodePool>
+class ConcurrentAVLTree
+{
+public:
+    ConcurrentAVLTree();
+    explicit ConcurrentAVLTree(const Compare& comp);
+
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+    bool find(const Key& key, Value& value) const;
+    bool contains(const Key& key) const;
+    template<typename Visitor>
+    void forEach(Visitor visit) const;
+    FrozenTree<Key, Value, Compare> freeze() const;
+    std::size_t size() const;
+    bool empty() const;
+    TreeStats stats() const;
+
+protected:
+    static const std::size_t READER_SLOTS = 64;
+
+    struct alignas(64) ReaderSlot
+    {
+        std::atomic<std::size_t> readers;
+    };
+
+    static std::size_t slotIndex();
+    std::atomic<std::size_t>& lockShared() const;
+    static void unlockShared(std::atomic<std::size_t>& readers);
+    void lock();
+    void unlock();
+
+    // Holds the read side for the lifetime of a scope
+    class ReadGuard
+    {
+    public:
+        explicit ReadGuard(const ConcurrentAVLTree& tree) : readers_(tree.lockShared()) { }
+        ~ReadGuard() { unlockShared(readers_); }
+    private:
+        std::atomic<std::size_t>& readers_;
+    };
+
+    // Holds the write side for the lifetime of a scope
+    class WriteGuard
+    {
+    public:
+        explicit WriteGuard(ConcurrentAVLTree& tree) : tree_(tree) { tree_.lock(); }
+        ~WriteGuard() { tree_.unlock(); }
+    private:
+        ConcurrentAVLTree& tree_;
+    };
+
+    AVLTree<Key, Value, Compare, Alloc> tree_;
+    mutable ReaderSlot slots_[READER_SLOTS];
+    std::atomic<bool> writing_;
+    std::mutex writeMutex_;
+};
+
+/*
+--------------------------------------------------------------
+Begin implementations for the ConcurrentAVLTree class.
+--------------------------------------------------------------
+*/
+
+template<class Key, class Value, class Compare, class Alloc>
+ConcurrentAVLTree<Key, Value, Compare, Alloc>::ConcurrentAVLTree() :
+    writing_(false)
+{
+    for (std::size_t i = 0; i < READER_SLOTS; ++i){
+      slots_[i].readers.store(0, std::memory_order_relaxed);
+    }
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+ConcurrentAVLTree<Key, Value, Compare, Alloc>::ConcurrentAVLTree(const Compare& comp) :
+    tree_(comp),
+    writing_(false)
+{
+    for (std::size_t i = 0; i < READER_SLOTS; ++i){
+      slots_[i].readers.store(0, std::memory_order_relaxed);
+    }
+}
+
+/**
+* The reader slot of the calling thread. Threads are dealt slots round
+* robin the first time they read, so up to READER_SLOTS readers never
+* share one.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+std::size_t ConcurrentAVLTree<Key, Value, Compare, Alloc>::slotIndex()
+{
+    static std::atomic<std::size_t> nextSlot(0);
+    thread_local std::size_t slot = nextSlot.fetch_add(1, std::memory_order_relaxed) % READER_SLOTS;
+    return slot;
+}
+
+/**
+* Registers the calling thread as a reader. The slot increment and the
+* flag load here, and the writer's flag store and slot loads in lock(),
+* are all sequentially consistent, so either the writer sees this
+* reader and waits, or this reader sees the flag and backs off. Returns
+* the slot to hand back to unlockShared.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+std::atomic<std::size_t>& ConcurrentAVLTree<Key, Value, Compare, Alloc>::lockShared() const
+{
+    std::atomic<std::size_t>& readers = slots_[slotIndex()].readers;
+    while (true){
+      readers.fetch_add(1, std::memory_order_seq_cst);
+      if (!writing_.load(std::memory_order_seq_cst)){
+        return readers;
+      }
+      readers.fetch_sub(1, std::memory_order_release);
+      while (writing_.load(std::memory_order_relaxed)){
+        std::this_thread::yield();
+      }
+    }
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+void ConcurrentAVLTree<Key, Value, Compare, Alloc>::unlockShared(std::atomic<std::size_t>& readers)
+{
+    readers.fetch_sub(1, std::memory_order_release);
+}
+
+/**
+* Takes the tree for writing: excludes other writers, stops new readers
+* and waits for the current ones to finish. The slot loads must be
+* sequentially consistent, not just acquire: an acquire load may be
+* ordered before the flag store, and then a reader and the writer could
+* each miss the other (see lockShared).
+*/
+template<class Key, class Value, class Compare, class Alloc>
+void ConcurrentAVLTree<Key, Value, Compare, Alloc>::lock()
+{
+    writeMutex_.lock();
+    writing_.store(true, std::memory_order_seq_cst);
+    for (std::size_t i = 0; i < READER_SLOTS; ++i){
+      while (slots_[i].readers.load(std::memory_order_seq_cst) != 0){
+        std::this_thread::yield();
+      }
+    }
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+void ConcurrentAVLTree<Key, Value, Compare, Alloc>::unlock()
+{
+    writing_.store(false, std::memory_order_release);
+    writeMutex_.unlock();
+}
+
+/**
+* Inserts the pair, overwriting the value if the key is already present
+*/
+template<class Key, class Value, class Compare, class Alloc>
+void ConcurrentAVLTree<Key, Value, Compare, Alloc>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    WriteGuard guard(*this);
+    tree_.insert(keyValuePair);
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+void ConcurrentAVLTree<Key, Value, Compare, Alloc>::remove(const Key& key)
+{
+    WriteGuard guard(*this);
+    tree_.remove(key);
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+void ConcurrentAVLTree<Key, Value, Compare, Alloc>::clear()
+{
+    WriteGuard guard(*this);
+    tree_.clear();
+}
+
+/**
+* Copies the value stored under key into value and returns true, or
+* returns false if the key is not present
+*/
+template<class Key, class Value, class Compare, class Alloc>
+bool ConcurrentAVLTree<Key, Value, Compare, Alloc>::find(const Key& key, Value& value) const
+{
+    ReadGuard guard(*this);
+    typename AVLTree<Key, Value, Compare, Alloc>::iterator it = tree_.find(key);
+    if (it == tree_.end()){
+      return false;
+    }
+    value = it->second;
+    return true;
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+bool ConcurrentAVLTree<Key, Value, Compare, Alloc>::contains(const Key& key) const
+{
+    ReadGuard guard(*this);
+    return tree_.find(key) != tree_.end();
+}
+
+/**
+* Calls visit(item) on every item in key order while holding the read
+* side, so the scan sees one consistent version of the tree. Writers
+* wait until it returns; visit must not call back into this tree's
+* writers.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+template<typename Visitor>
+void ConcurrentAVLTree<Key, Value, Compare, Alloc>::forEach(Visitor visit) const
+{
+    ReadGuard guard(*this);
+    tree_.forEach([&visit](const std::pair<const Key, Value>& item){
+      visit(item);
+    });
+}
+
+/**
+* A consistent read-only copy (see frozen_tree.h) that other threads can
+* keep reading without any locking.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+FrozenTree<Key, Value, Compare> ConcurrentAVLTree<Key, Value, Compare, Alloc>::freeze() const
+{
+    ReadGuard guard(*this);
+    return tree_.freeze();
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+std::size_t ConcurrentAVLTree<Key, Value, Compare, Alloc>::size() const
+{
+    ReadGuard guard(*this);
+    return tree_.size();
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+bool ConcurrentAVLTree<Key, Value, Compare, Alloc>::empty() const
+{
+    ReadGuard guard(*this);
+    return tree_.empty();
+}
+
+/*
+* The shape of the tree under the read lock. With BST_STATS, counts from
+* concurrent readers are approximate; see OperationCounter.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+TreeStats ConcurrentAVLTree<Key, Value, Compare, Alloc>::stats() const
+{
+    ReadGuard guard(*this);
+    return tree_.stats();
+}
+
+/*
+------------------------------------------------------------
+End implementations for the ConcurrentAVLTree class.
+------------------------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,499 @@
+#ifndef FROZEN_TREE_H
+#define FROZEN_TREE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "key_order.h"
+
+// The batched lookups have AVX2 and SSE4.2 versions for 64-bit integer
+// keys, picked at run time, on x86-64 with GCC or Clang
+#if defined(__GNUC__) && defined(__x86_64__)
+#define FROZEN_TREE_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+/**
+* The descent shared by the batched lookups of FrozenTree: each query
+* starts at BFS position 1 and takes levels steps down an Eytzinger
+* array, going to 2k + 1 where the key at k is less than the query and
+* to 2k otherwise. nodes[i] receives the position query i reached.
+*
+* The Simd parameter selects the vectorized version below for 64-bit
+* integer keys under std::less. This version works for any key and
+* order. It runs the queries in groups of GROUP side by side, one level
+* at a time, so the cache misses of a group overlap; the step is a
+* select, not a branch.
+*/
+template<typename Key, typename Compare,
+         bool Simd = std::is_integral<Key>::value && sizeof(Key) == 8 &&
+                     std::is_same<Compare, std::less<Key> >::value>
+class FrozenSearch
+{
+public:
+    static const std::size_t GROUP = 16;
+
+    static void descend(const Key* tree, std::size_t levels, const Compare& comp,
+                        const Key* queries, std::size_t count, std::size_t* nodes)
+    {
+        for (std::size_t i = 0; i < count; i += GROUP){
+          std::size_t lanes = count - i;
+          if (lanes > GROUP){
+            lanes = GROUP;
+          }
+          std::size_t k[GROUP];
+          for (std::size_t j = 0; j < lanes; ++j){
+            k[j] = 1;
+          }
+          for (std::size_t level = 0; level < levels; ++level){
+            for (std::size_t j = 0; j < lanes; ++j){
+              k[j] = 2 * k[j] + KeyOrder<Key, Compare>::less(comp, tree[k[j]], queries[i + j]);
+            }
+          }
+          for (std::size_t j = 0; j < lanes; ++j){
+            nodes[i + j] = k[j];
+          }
+        }
+    }
+};
+
+/**
+* 64-bit integer keys in ascending order: the same descent with vector
+* compares where the CPU has them. AVX2 fetches four tree keys with one
+* gather and steps four queries at once; SSE4.2, which has the 64-bit
+* compare but no gather, steps two. Unsigned keys have their top bit
+* flipped on both sides so the signed compare orders them correctly.
+* Other CPUs and compilers use the generic version.
+*/
+template<typename Key, typename Compare>
+class FrozenSearch<Key, Compare, true>
+{
+public:
+    static void descend(const Key* tree, std::size_t levels, const Compare& comp,
+                        const Key* queries, std::size_t count, std::size_t* nodes)
+    {
+#ifdef FROZEN_TREE_X86_SIMD
+        switch (simdLevel()){
+        case 2:
+          descendAvx2(tree, levels, queries, count, nodes);
+          return;
+        case 1:
+          descendSse42(tree, levels, queries, count, nodes);
+          return;
+        }
+#endif
+        FrozenSearch<Key, Compare, false>::descend(tree, levels, comp, queries, count, nodes);
+    }
+
+#ifdef FROZEN_TREE_X86_SIMD
+    // queries stepped side by side; more than the scalar version, since
+    // a gather puts several loads in flight for one instruction
+    static const int LANES = 32;
+
+    /**
+    * 2 with AVX2, 1 with SSE4.2 only, otherwise 0; checked once.
+    */
+    static int simdLevel()
+    {
+        static const int level = detectSimd();
+        return level;
+    }
+
+    static int detectSimd()
+    {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")){
+          return 2;
+        }
+        return __builtin_cpu_supports("sse4.2") ? 1 : 0;
+    }
+
+    static long long signFlip()
+    {
+        return std::is_signed<Key>::value ? 0 : (long long)(1ULL << 63);
+    }
+
+    /**
+    * LANES queries at a time in 4-lane vectors; the tail, if any, goes
+    * to the generic version.
+    */
+    __attribute__((target("avx2")))
+    static void descendAvx2(const Key* tree, std::size_t levels, const Key* queries,
+                            std::size_t count, std::size_t* nodes)
+    {
+        const long long* keys = reinterpret_cast<const long long*>(tree);
+        const __m256i flip = _mm256_set1_epi64x(signFlip());
+        const int VECTORS = LANES / 4;
+        std::size_t i = 0;
+        for (; i + LANES <= count; i += LANES){
+          __m256i q[VECTORS];
+          __m256i k[VECTORS];
+          for (int v = 0; v < VECTORS; ++v){
+            q[v] = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(queries + i + 4 * v)), flip);
+            k[v] = _mm256_set1_epi64x(1);
+          }
+          for (std::size_t level = 0; level < levels; ++level){
+            for (int v = 0; v < VECTORS; ++v){
+              __m256i node = _mm256_xor_si256(_mm256_i64gather_epi64(keys, k[v], 8), flip);
+              // all ones where the tree key is less than the query
+              __m256i less = _mm256_cmpgt_epi64(q[v], node);
+              k[v] = _mm256_sub_epi64(_mm256_add_epi64(k[v], k[v]), less);
+            }
+          }
+          for (int v = 0; v < VECTORS; ++v){
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(nodes + i + 4 * v), k[v]);
+          }
+        }
+        FrozenSearch<Key, Compare, false>::descend(tree, levels, Compare(), queries + i, count - i, nodes + i);
+    }
+
+    /**
+    * As descendAvx2, in 2-lane vectors loaded from scalar reads.
+    */
+    __attribute__((target("sse4.2")))
+    static void descendSse42(const Key* tree, std::size_t levels, const Key* queries,
+                             std::size_t count, std::size_t* nodes)
+    {
+        const __m128i flip = _mm_set1_epi64x(signFlip());
+        const int VECTORS = LANES / 2;
+        std::size_t i = 0;
+        for (; i + LANES <= count; i += LANES){
+          __m128i q[VECTORS];
+          __m128i k[VECTORS];
+          for (int v = 0; v < VECTORS; ++v){
+            q[v] = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(queries + i + 2 * v)), flip);
+            k[v] = _mm_set1_epi64x(1);
+          }
+          for (std::size_t level = 0; level < levels; ++level){
+            for (int v = 0; v < VECTORS; ++v){
+              __m128i node = _mm_set_epi64x((long long)tree[_mm_extract_epi64(k[v], 1)],
+                                            (long long)tree[_mm_cvtsi128_si64(k[v])]);
+              __m128i less = _mm_cmpgt_epi64(q[v], _mm_xor_si128(node, flip));
+              k[v] = _mm_sub_epi64(_mm_add_epi64(k[v], k[v]), less);
+            }
+          }
+          for (int v = 0; v < VECTORS; ++v){
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(nodes + i + 2 * v), k[v]);
+          }
+        }
+        FrozenSearch<Key, Compare, false>::descend(tree, levels, Compare(), queries + i, count - i, nodes + i);
+    }
+#endif
+};
+
+/**
+* An immutable, pointer-free snapshot of a search tree, made by
+* BinarySearchTree::freeze().
+*
+* The keys are stored in Eytzinger (BFS) order: the root at index 1 and
+* the children of k at 2k and 2k + 1, all in one array. A lookup walks
+* that array with no pointers to chase and no data-dependent branches,
+* and prefetches the cache line holding the descendants a few levels
+* ahead while it compares. The items themselves are kept in key order
+* next to it for iteration. Keys are ordered by Compare, as in the tree
+* the snapshot was made from.
+*
+* lowerBoundMany() and findMany() answer a batch of keys at once, with
+* the descents interleaved and, for 64-bit integer keys, vectorized.
+*/
+template <typename Key, typename Value, typename Compare = std::less<Key> >
+class FrozenTree
+{
+public:
+    typedef typename std::vector<std::pair<const Key, Value> >::const_iterator iterator;
+
+    FrozenTree();
+    explicit FrozenTree(std::vector<std::pair<const Key, Value> >& sortedItems, const Compare& comp = Compare());
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    iterator lower_bound(const Key& key) const;
+    template<typename InputIt, typename OutputIt>
+    OutputIt lowerBoundMany(InputIt first, InputIt last, OutputIt out) const;
+    template<typename InputIt, typename OutputIt>
+    OutputIt findMany(InputIt first, InputIt last, OutputIt out) const;
+    Value const & operator[](const Key& key) const;
+    std::size_t size() const;
+    bool empty() const;
+
+protected:
+    std::size_t fillLayout(std::size_t i, std::size_t k);
+    std::size_t lowerBoundIndex(const Key& key) const;
+    void lowerBoundIndices(const Key* keys, std::size_t count, std::size_t* indices) const;
+    static std::size_t lastLeftTurn(std::size_t k);
+    // keys the batched lookups hand to the descent at a time
+    static const std::size_t BATCH = 256;
+
+    // sorted items, the order the iterator walks
+    std::vector<std::pair<const Key, Value> > items_;
+    // eytzinger_[k] is the key at BFS position k (index 0 unused)
+    std::vector<Key> eytzinger_;
+    // position in items_ of the key at BFS position k
+    std::vector<std::size_t> rank_;
+    Compare comp_;
+};
+
+/*
+-----------------------------------------------------
+Begin implementations for the FrozenTree class.
+-----------------------------------------------------
+*/
+
+/**
+* An empty snapshot.
+*/
+template<typename Key, typename Value, typename Compare>
+FrozenTree<Key, Value, Compare>::FrozenTree()
+{
+
+}
+
+/**
+* Builds the snapshot from items sorted by strictly increasing key
+* under comp, taking them over from sortedItems.
+*/
+template<typename Key, typename Value, typename Compare>
+FrozenTree<Key, Value, Compare>::FrozenTree(std::vector<std::pair<const Key, Value> >& sortedItems, const Compare& comp) :
+    comp_(comp)
+{
+    items_.swap(sortedItems);
+    if (items_.empty()){
+      return;
+    }
+    eytzinger_.assign(items_.size() + 1, items_[0].first);
+    rank_.assign(items_.size() + 1, 0);
+    fillLayout(0, 1);
+}
+
+/**
+* Fills the BFS subtree rooted at position k with items_[i...] in order
+* and returns the index of the next unused item.
+*/
+template<typename Key, typename Value, typename Compare>
+std::size_t FrozenTree<Key, Value, Compare>::fillLayout(std::size_t i, std::size_t k)
+{
+    if (k < eytzinger_.size()){
+      i = fillLayout(i, 2 * k);
+      eytzinger_[k] = items_[i].first;
+      rank_[k] = i;
+      ++i;
+      i = fillLayout(i, 2 * k + 1);
+    }
+    return i;
+}
+
+template<typename Key, typename Value, typename Compare>
+typename FrozenTree<Key, Value, Compare>::iterator
+FrozenTree<Key, Value, Compare>::begin() const
+{
+    return items_.begin();
+}
+
+template<typename Key, typename Value, typename Compare>
+typename FrozenTree<Key, Value, Compare>::iterator
+FrozenTree<Key, Value, Compare>::end() const
+{
+    return items_.end();
+}
+
+template<typename Key, typename Value, typename Compare>
+std::size_t FrozenTree<Key, Value, Compare>::size() const
+{
+    return items_.size();
+}
+
+template<typename Key, typename Value, typename Compare>
+bool FrozenTree<Key, Value, Compare>::empty() const
+{
+    return items_.empty();
+}
+
+/**
+* Position in items_ of the first key not less than key, or size()
+* if there is none.
+*/
+template<typename Key, typename Value, typename Compare>
+std::size_t FrozenTree<Key, Value, Compare>::lowerBoundIndex(const Key& key) const
+{
+    const std::size_t n = items_.size();
+    const Key* keys = eytzinger_.data();
+    // number of keys per cache line: k's descendants d levels down
+    // start at k * 2^d, so k * perLine is the line-sized block 3 levels
+    // below k for 8-byte keys (4 levels for 4-byte keys)
+    const std::size_t perLine = (sizeof(Key) >= 64) ? 1 : 64 / sizeof(Key);
+    std::size_t k = 1;
+    while (k <= n){
+#if defined(__GNUC__)
+      __builtin_prefetch(keys + k * perLine);
+#endif
+      k = 2 * k + KeyOrder<Key, Compare>::less(comp_, keys[k], key);
+    }
+    k = lastLeftTurn(k);
+    return (k == 0) ? n : rank_[k];
+}
+
+/**
+* Where a descent that ended at BFS position k last went left: undoes
+* the trailing right turns plus that left turn. 0 if it never did.
+*/
+template<typename Key, typename Value, typename Compare>
+std::size_t FrozenTree<Key, Value, Compare>::lastLeftTurn(std::size_t k)
+{
+#if defined(__GNUC__)
+    return k >> (__builtin_ctzll(~(unsigned long long)k) + 1);
+#else
+    while (k & 1){
+      k >>= 1;
+    }
+    return k >> 1;
+#endif
+}
+
+/**
+* lowerBoundIndex() for count keys at once, through FrozenSearch. The
+* levels that are full in the Eytzinger array (all but the last) are
+* descended in bulk; the last, partial level and the walk back up are
+* done per key as in lowerBoundIndex().
+*/
+template<typename Key, typename Value, typename Compare>
+void FrozenTree<Key, Value, Compare>::lowerBoundIndices(const Key* keys, std::size_t count, std::size_t* indices) const
+{
+    const std::size_t n = items_.size();
+    if (n == 0){
+      for (std::size_t i = 0; i < count; ++i){
+        indices[i] = 0;
+      }
+      return;
+    }
+    // level d is full when 2^(d+1) - 1 <= n
+    std::size_t levels = 0;
+    while ((std::size_t(2) << levels) - 1 <= n){
+      ++levels;
+    }
+    const Key* tree = eytzinger_.data();
+    FrozenSearch<Key, Compare>::descend(tree, levels, comp_, keys, count, indices);
+    // two passes, each a short loop with no branch on the keys, so the
+    // cache misses of different keys overlap
+    for (std::size_t i = 0; i < count; ++i){
+      std::size_t k = indices[i];
+      bool inTree = k <= n;
+      std::size_t stepped = 2 * k + KeyOrder<Key, Compare>::less(comp_, tree[inTree ? k : 0], keys[i]);
+      indices[i] = lastLeftTurn(inTree ? stepped : k);
+    }
+    for (std::size_t i = 0; i < count; ++i){
+      std::size_t k = indices[i];
+      indices[i] = (k == 0) ? n : rank_[k];
+    }
+}
+
+/**
+* Writes lower_bound(key) to out for every key in [first, last), in
+* order, and returns out past the last iterator written. For 64-bit
+* integer keys under std::less the descent uses AVX2 or SSE4.2 where
+* the CPU has it (see FrozenSearch); otherwise it interleaves scalar
+* searches. Either way, batches of a few dozen keys or more are much
+* cheaper per key than calling lower_bound() for each.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename InputIt, typename OutputIt>
+OutputIt FrozenTree<Key, Value, Compare>::lowerBoundMany(InputIt first, InputIt last, OutputIt out) const
+{
+    std::vector<Key> keys;
+    keys.reserve(BATCH);
+    std::size_t indices[BATCH];
+    while (first != last){
+      keys.clear();
+      while (keys.size() < BATCH && first != last){
+        keys.push_back(*first);
+        ++first;
+      }
+      lowerBoundIndices(keys.data(), keys.size(), indices);
+      for (std::size_t i = 0; i < keys.size(); ++i){
+        *out = items_.begin() + indices[i];
+        ++out;
+      }
+    }
+    return out;
+}
+
+/**
+* Writes find(key) to out for every key in [first, last), in order: the
+* item with that key, or end() if it is missing. Batched the same way
+* as lowerBoundMany().
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename InputIt, typename OutputIt>
+OutputIt FrozenTree<Key, Value, Compare>::findMany(InputIt first, InputIt last, OutputIt out) const
+{
+    std::vector<Key> keys;
+    keys.reserve(BATCH);
+    std::size_t indices[BATCH];
+    while (first != last){
+      keys.clear();
+      while (keys.size() < BATCH && first != last){
+        keys.push_back(*first);
+        ++first;
+      }
+      lowerBoundIndices(keys.data(), keys.size(), indices);
+      for (std::size_t i = 0; i < keys.size(); ++i){
+        std::size_t k = indices[i];
+        if (k != items_.size() && KeyOrder<Key, Compare>::less(comp_, keys[i], items_[k].first)){
+          k = items_.size();
+        }
+        *out = items_.begin() + k;
+        ++out;
+      }
+    }
+    return out;
+}
+
+/**
+* Returns an iterator to the first item whose key is not less than key,
+* or the end iterator if there is none
+*/
+template<typename Key, typename Value, typename Compare>
+typename FrozenTree<Key, Value, Compare>::iterator
+FrozenTree<Key, Value, Compare>::lower_bound(const Key& key) const
+{
+    return items_.begin() + lowerBoundIndex(key);
+}
+
+/**
+* Returns an iterator to the item with the given key, or the end
+* iterator if it does not exist
+*/
+template<typename Key, typename Value, typename Compare>
+typename FrozenTree<Key, Value, Compare>::iterator
+FrozenTree<Key, Value, Compare>::find(const Key& key) const
+{
+    iterator it = lower_bound(key);
+    if (it != items_.end() && KeyOrder<Key, Compare>::less(comp_, key, it->first)){
+      return items_.end();
+    }
+    return it;
+}
+
+/**
+ * @precondition The key exists in the map
+ * Returns the value associated with the key
+ */
+template<typename Key, typename Value, typename Compare>
+Value const & FrozenTree<Key, Value, Compare>::operator[](const Key& key) const
+{
+    iterator it = find(key);
+    if (it == items_.end()) throw std::out_of_range("Invalid key");
+    return it->second;
+}
+
+/*
+---------------------------------------------------
+End implementations for the FrozenTree class.
+---------------------------------------------------
+*/
+
+#endif
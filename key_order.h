@@ -0,0 +1,138 @@
+#ifndef KEY_ORDER_H
+#define KEY_ORDER_H
+
+#include <functional>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+/**
+ * How the search trees in bst.h and avlbst.h order keys through their
+ * Compare parameter (std::less<Key> by default, as for std::map).
+ *
+ * A descent needs one three-way answer per node: the key is below, at
+ * or above the node's. KeyOrder<Key, Compare>::compare gives it with at
+ * most two calls of Compare, and with a single call for std::string
+ * keys under std::less, whose compare() is one memcmp. less() is the
+ * plain Compare call; for std::less<Key>, which only takes Keys, it also
+ * accepts the lookup types IsLookupKey allows and uses their operator<.
+ */
+template<typename Key, typename Compare>
+class KeyOrder
+{
+public:
+    template<typename A, typename B>
+    static bool less(const Compare& comp, const A& a, const B& b)
+    {
+        return comp(a, b);
+    }
+
+    template<typename A, typename B>
+    static int compare(const Compare& comp, const A& a, const B& b)
+    {
+        return comp(a, b) ? -1 : (comp(b, a) ? 1 : 0);
+    }
+};
+
+template<typename Key>
+class KeyOrder<Key, std::less<Key> >
+{
+public:
+    static bool less(const std::less<Key>& comp, const Key& a, const Key& b)
+    {
+        return comp(a, b);
+    }
+
+    template<typename A, typename B>
+    static bool less(const std::less<Key>&, const A& a, const B& b)
+    {
+        return a < b;
+    }
+
+    template<typename A, typename B>
+    static int compare(const std::less<Key>& comp, const A& a, const B& b)
+    {
+        return less(comp, a, b) ? -1 : (less(comp, b, a) ? 1 : 0);
+    }
+};
+
+/**
+ * Strings under std::less: compare() orders them the same way as
+ * operator< in one pass, for std::string_view lookups too.
+ */
+template<typename CharT, typename Traits, typename A>
+class KeyOrder<std::basic_string<CharT, Traits, A>, std::less<std::basic_string<CharT, Traits, A> > >
+{
+    typedef std::basic_string<CharT, Traits, A> String;
+
+    template<typename X, typename Y>
+    static auto compareWith(const X& a, const Y& b, int) -> decltype(int(a.compare(b)))
+    {
+        return a.compare(b);
+    }
+
+    template<typename X, typename Y>
+    static int compareWith(const X& a, const Y& b, long)
+    {
+        return (a < b) ? -1 : ((b < a) ? 1 : 0);
+    }
+
+public:
+    static bool less(const std::less<String>& comp, const String& a, const String& b)
+    {
+        return comp(a, b);
+    }
+
+    template<typename X, typename Y>
+    static bool less(const std::less<String>&, const X& a, const Y& b)
+    {
+        return a < b;
+    }
+
+    template<typename X, typename Y>
+    static int compare(const std::less<String>&, const X& a, const Y& b)
+    {
+        return compareWith(a, b, 0);
+    }
+};
+
+/**
+ * IsLookupKey<Key, K, Compare>::value is true when a tree can be searched
+ * with a K as it is, without building a temporary Key first.
+ *
+ * With a transparent comparator (one that declares is_transparent, like
+ * std::less<> in C++14) that is any K, as for std::map. With the default
+ * std::less<Key>, K must order against Key with operator< both ways but
+ * not convert to Key implicitly, like std::string_view against
+ * std::string. Types that do convert (a C string, or 1.5 for int keys)
+ * still become one Key up front, which is also cheaper than measuring a
+ * C string again at every node.
+ */
+template<typename Key, typename K, typename Compare = std::less<Key> >
+class IsLookupKey
+{
+    template<typename C>
+    static std::true_type test(typename C::is_transparent*);
+    template<typename C>
+    static std::false_type test(...);
+
+public:
+    static const bool value = decltype(test<Compare>(0))::value;
+};
+
+template<typename Key, typename K>
+class IsLookupKey<Key, K, std::less<Key> >
+{
+    template<typename A, typename B>
+    static auto test(int) -> decltype((void)(std::declval<const A&>() < std::declval<const B&>()),
+                                      (void)(std::declval<const B&>() < std::declval<const A&>()),
+                                      std::true_type());
+    template<typename A, typename B>
+    static std::false_type test(...);
+
+public:
+    static const bool value = !std::is_convertible<const K&, Key>::value &&
+                              decltype(test<Key, K>(0))::value;
+};
+
+#endif
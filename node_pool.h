@@ -0,0 +1,299 @@
+#ifndef NODE_POOL_H
+#define NODE_POOL_H
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <vector>
+
+/**
+ * Node allocators for the search trees in bst.h and avlbst.h.
+ *
+ * A node allocator provides:
+ *   void* allocate(std::size_t size);
+ *   void deallocate(void* p, std::size_t size);
+ *   void release();   // called once every node has been deallocated
+ *   void share(Alloc& other);  // nodes may now move between the two
+ *   void adopt(Alloc& other);  // take over other's unused blocks
+ *   static const bool releasesAll;
+ *
+ * When releasesAll is true, release() frees every block the allocator
+ * ever handed out, so a tree whose keys and values need no destructor
+ * can be cleared without visiting its nodes.
+ *
+ * share() is called before one tree hands nodes to another (AVLTree's
+ * split/join); afterwards either allocator may deallocate blocks that
+ * came from the other.
+ *
+ * adopt() is called before a short-lived tree that worked on another
+ * tree's nodes goes away (AVLTree's parallel set operations, the
+ * worker pools of a parallel build), so the blocks it freed or never
+ * handed out can be reused by the tree that stays.
+ */
+
+/**
+ * Slab/free-list pool owned by a single tree. Nodes are carved out of
+ * contiguous slabs that double in size, removed nodes go on a free list
+ * for reuse by the next insert, and release() hands the slabs back in
+ * O(number of slabs). Every node of one tree has the same size, so the
+ * block size is fixed by the first allocation.
+ *
+ * The slabs belong to a reference-counted arena. Pools that share()
+ * hold references to each other's arenas, so nodes that moved to
+ * another tree stay valid after this one releases; an arena's memory
+ * goes back once no pool refers to it.
+ */
+class NodePool
+{
+public:
+    static const bool releasesAll = true;
+
+    NodePool();
+    ~NodePool();
+
+    void* allocate(std::size_t size);
+    void deallocate(void* p, std::size_t size);
+    void release();
+    void share(NodePool& other);
+    void adopt(NodePool& other);
+
+private:
+    NodePool(const NodePool&) = delete;
+    NodePool& operator=(const NodePool&) = delete;
+
+    void addSlab();
+
+    struct FreeBlock
+    {
+        FreeBlock* next;
+    };
+    struct Slab
+    {
+        Slab* next;
+    };
+    struct Arena
+    {
+        Arena();
+        ~Arena();
+        Slab* slabs;
+    };
+    void addArenas(const NodePool& other);
+
+    static const std::size_t ALIGN = alignof(std::max_align_t);
+    static const std::size_t FIRST_SLAB_BLOCKS = 32;
+    static const std::size_t MAX_SLAB_BLOCKS = 8192;
+
+    std::shared_ptr<Arena> arena_;                  // where new slabs go
+    std::vector<std::shared_ptr<Arena> > shared_;   // arenas of pools shared with
+    FreeBlock* free_;
+    char* cursor_;
+    char* end_;
+    std::size_t blockSize_;
+    std::size_t slabBlocks_;
+};
+
+/**
+ * Allocator that hands every node to the global operator new/delete,
+ * matching the behaviour of the trees before pooling was added.
+ */
+class NewNodeAllocator
+{
+public:
+    static const bool releasesAll = false;
+
+    void* allocate(std::size_t size)
+    {
+        return ::operator new(size);
+    }
+    void deallocate(void* p, std::size_t)
+    {
+        ::operator delete(p);
+    }
+    void release()
+    {
+    }
+    void share(NewNodeAllocator&)
+    {
+    }
+    void adopt(NewNodeAllocator&)
+    {
+    }
+};
+
+/*
+  -----------------------------------------
+  Begin implementations for the NodePool class.
+  -----------------------------------------
+*/
+
+inline NodePool::Arena::Arena() :
+    slabs(NULL)
+{
+
+}
+
+inline NodePool::Arena::~Arena()
+{
+    while(slabs != NULL) {
+        Slab* next = slabs->next;
+        ::operator delete(slabs);
+        slabs = next;
+    }
+}
+
+inline NodePool::NodePool() :
+    free_(NULL),
+    cursor_(NULL),
+    end_(NULL),
+    blockSize_(0),
+    slabBlocks_(FIRST_SLAB_BLOCKS)
+{
+
+}
+
+inline NodePool::~NodePool()
+{
+    release();
+}
+
+/**
+* Returns a block of at least size bytes, preferring recently freed blocks.
+*/
+inline void* NodePool::allocate(std::size_t size)
+{
+    if(blockSize_ == 0) {
+        std::size_t minSize = (size < sizeof(FreeBlock)) ? sizeof(FreeBlock) : size;
+        blockSize_ = (minSize + ALIGN - 1) / ALIGN * ALIGN;
+    }
+    if(size > blockSize_) {
+        throw std::bad_alloc();
+    }
+    if(free_ != NULL) {
+        FreeBlock* block = free_;
+        free_ = block->next;
+        return block;
+    }
+    if(cursor_ == end_) {
+        addSlab();
+    }
+    void* block = cursor_;
+    cursor_ += blockSize_;
+    return block;
+}
+
+/**
+* Puts a block back on the free list. The memory stays in its slab
+* until release().
+*/
+inline void NodePool::deallocate(void* p, std::size_t)
+{
+    FreeBlock* block = static_cast<FreeBlock*>(p);
+    block->next = free_;
+    free_ = block;
+}
+
+/**
+* Frees every slab. Any block handed out earlier becomes invalid, except
+* in slabs a pool this one shared with still refers to.
+*/
+inline void NodePool::release()
+{
+    arena_.reset();
+    shared_.clear();
+    free_ = NULL;
+    cursor_ = NULL;
+    end_ = NULL;
+    slabBlocks_ = FIRST_SLAB_BLOCKS;
+}
+
+/**
+* Lets this pool and other hold blocks from each other: each keeps the
+* other's slabs alive from now on. Both must serve the same node type.
+*/
+inline void NodePool::share(NodePool& other)
+{
+    if(&other == this) {
+        return;
+    }
+    if(blockSize_ == 0) {
+        blockSize_ = other.blockSize_;
+    }
+    else if(other.blockSize_ == 0) {
+        other.blockSize_ = blockSize_;
+    }
+    addArenas(other);
+    other.addArenas(*this);
+}
+
+/**
+* Moves other's unused blocks to this pool: its free list and the rest
+* of its current slab. Shares with other first, so the blocks stay valid
+* after other releases. Without this a pool's free blocks are lost for
+* reuse when it is released, though their memory lives on in the arena.
+*/
+inline void NodePool::adopt(NodePool& other)
+{
+    if(&other == this) {
+        return;
+    }
+    share(other);
+    while(other.cursor_ != other.end_) {
+        deallocate(other.cursor_, blockSize_);
+        other.cursor_ += other.blockSize_;
+    }
+    if(other.free_ != NULL) {
+        FreeBlock* last = other.free_;
+        while(last->next != NULL) {
+            last = last->next;
+        }
+        last->next = free_;
+        free_ = other.free_;
+        other.free_ = NULL;
+    }
+}
+
+/**
+* Adds references to every arena other holds that this pool lacks.
+*/
+inline void NodePool::addArenas(const NodePool& other)
+{
+    std::vector<std::shared_ptr<Arena> > theirs(other.shared_);
+    theirs.push_back(other.arena_);
+    for(std::size_t i = 0; i < theirs.size(); ++i) {
+        if(!theirs[i] || theirs[i] == arena_) {
+            continue;
+        }
+        bool known = false;
+        for(std::size_t j = 0; j < shared_.size() && !known; ++j) {
+            known = (shared_[j] == theirs[i]);
+        }
+        if(!known) {
+            shared_.push_back(theirs[i]);
+        }
+    }
+}
+
+inline void NodePool::addSlab()
+{
+    if(!arena_) {
+        arena_ = std::make_shared<Arena>();
+    }
+    std::size_t header = (sizeof(Slab) + ALIGN - 1) / ALIGN * ALIGN;
+    char* mem = static_cast<char*>(::operator new(header + slabBlocks_ * blockSize_));
+    Slab* slab = reinterpret_cast<Slab*>(mem);
+    slab->next = arena_->slabs;
+    arena_->slabs = slab;
+    cursor_ = mem + header;
+    end_ = cursor_ + slabBlocks_ * blockSize_;
+    if(slabBlocks_ < MAX_SLAB_BLOCKS) {
+        slabBlocks_ *= 2;
+    }
+}
+
+/*
+  ---------------------------------------
+  End implementations for the NodePool class.
+  ---------------------------------------
+*/
+
+#endif
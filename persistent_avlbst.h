@@ -0,0 +1,592 @@
+#ifndef PERSISTENT_AVLBST_H
+#define PERSISTENT_AVLBST_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+/**
+* A copy-on-write AVL tree whose versions share structure.
+*
+* snapshot() (or the copy constructor) is O(1): the copy just takes a
+* reference to the same root. Nodes are reference counted, and a node
+* reachable from more than one version is never changed in place:
+* insert and remove copy the O(log n) nodes on their path that are
+* shared and reuse the rest, so the other versions keep seeing exactly
+* what they saw. A node with a single owner is updated in place, so a
+* tree with no live snapshots mutates without copying anything. A
+* version's nodes are freed when the last version using them goes away.
+*
+* Versions can be read and released on different threads; a single
+* version must not be modified while another thread is using it.
+*/
+template <typename Key, typename Value>
+class PersistentAVLTree
+{
+protected:
+    struct PNode
+    {
+        PNode(const std::pair<const Key, Value>& item);
+        PNode(const PNode& other);
+        std::pair<const Key, Value> item_;
+        PNode* left_;
+        PNode* right_;
+        int8_t height_;                  // 1 for a leaf
+        std::atomic<std::size_t> refs_;  // versions and parents pointing here
+    };
+
+public:
+    PersistentAVLTree();
+    PersistentAVLTree(const PersistentAVLTree& other);
+    PersistentAVLTree& operator=(const PersistentAVLTree& other);
+    ~PersistentAVLTree();
+
+    PersistentAVLTree snapshot() const;
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+    bool empty() const;
+    std::size_t size() const;
+    bool isBalanced() const;
+
+    /**
+    * A read-only iterator over one version in key order. It keeps the
+    * path from the root on a stack, since nodes shared between versions
+    * cannot hold a parent pointer, and stays valid while that version
+    * is alive and unmodified.
+    */
+    class iterator
+    {
+    public:
+        iterator();
+
+        const std::pair<const Key, Value>& operator*() const;
+        const std::pair<const Key, Value>* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class PersistentAVLTree<Key, Value>;
+        void pushLeftSpine(const PNode* n);
+        // nodes still to visit, the current one on top
+        std::vector<const PNode*> path_;
+    };
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    Value const & operator[](const Key& key) const;
+
+protected:
+    static void retain(PNode* n);
+    static void release(PNode* n);
+    static PNode* makeUnique(PNode* n);
+    static int height(const PNode* n);
+    static PNode* rebalance(PNode* n);
+    static PNode* rotateLeft(PNode* n);
+    static PNode* rotateRight(PNode* n);
+    static PNode* insertHelper(PNode* n, const std::pair<const Key, Value>& item, bool& inserted);
+    static PNode* removeHelper(PNode* n, const Key& key);
+    static PNode* detachSmallest(PNode* n, PNode*& smallest);
+    static int isBalancedHelper(const PNode* n);
+
+    PNode* root_;
+    std::size_t count_;
+};
+
+/*
+  -----------------------------------------
+  Begin implementations for the PNode struct.
+  -----------------------------------------
+*/
+
+template<typename Key, typename Value>
+PersistentAVLTree<Key, Value>::PNode::PNode(const std::pair<const Key, Value>& item) :
+    item_(item),
+    left_(NULL),
+    right_(NULL),
+    height_(1),
+    refs_(1)
+{
+
+}
+
+/**
+* A private copy of other for a version that is about to change it. The
+* copy shares other's children, so it takes a reference to each.
+*/
+template<typename Key, typename Value>
+PersistentAVLTree<Key, Value>::PNode::PNode(const PNode& other) :
+    item_(other.item_),
+    left_(other.left_),
+    right_(other.right_),
+    height_(other.height_),
+    refs_(1)
+{
+    retain(left_);
+    retain(right_);
+}
+
+/*
+  ---------------------------------------
+  End implementations for the PNode struct.
+  ---------------------------------------
+*/
+
+/*
+--------------------------------------------------------------
+Begin implementations for the PersistentAVLTree::iterator class.
+---------------------------------------------------------------
+*/
+
+/**
+* A default constructor that initializes the iterator to the end.
+*/
+template<typename Key, typename Value>
+PersistentAVLTree<Key, Value>::iterator::iterator()
+{
+
+}
+
+template<typename Key, typename Value>
+const std::pair<const Key, Value>&
+PersistentAVLTree<Key, Value>::iterator::operator*() const
+{
+    return path_.back()->item_;
+}
+
+template<typename Key, typename Value>
+const std::pair<const Key, Value>*
+PersistentAVLTree<Key, Value>::iterator::operator->() const
+{
+    return &(path_.back()->item_);
+}
+
+template<typename Key, typename Value>
+bool PersistentAVLTree<Key, Value>::iterator::operator==(const iterator& rhs) const
+{
+    const PNode* mine = path_.empty() ? NULL : path_.back();
+    const PNode* theirs = rhs.path_.empty() ? NULL : rhs.path_.back();
+    return mine == theirs;
+}
+
+template<typename Key, typename Value>
+bool PersistentAVLTree<Key, Value>::iterator::operator!=(const iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+/**
+* Moves to the smallest key in the right subtree, or else to the
+* nearest ancestor still waiting on the stack.
+*/
+template<typename Key, typename Value>
+typename PersistentAVLTree<Key, Value>::iterator&
+PersistentAVLTree<Key, Value>::iterator::operator++()
+{
+    if (path_.empty()){
+      return *this;
+    }
+    const PNode* curr = path_.back();
+    path_.pop_back();
+    pushLeftSpine(curr->right_);
+    return *this;
+}
+
+template<typename Key, typename Value>
+void PersistentAVLTree<Key, Value>::iterator::pushLeftSpine(const PNode* n)
+{
+    while (n != NULL){
+      path_.push_back(n);
+      n = n->left_;
+    }
+}
+
+/*
+-------------------------------------------------------------
+End implementations for the PersistentAVLTree::iterator class.
+-------------------------------------------------------------
+*/
+
+/*
+-----------------------------------------------------
+Begin implementations for the PersistentAVLTree class.
+-----------------------------------------------------
+*/
+
+template<typename Key, typename Value>
+PersistentAVLTree<Key, Value>::PersistentAVLTree() :
+    root_(NULL),
+    count_(0)
+{
+
+}
+
+/**
+* O(1): the new version shares every node with other.
+*/
+template<typename Key, typename Value>
+PersistentAVLTree<Key, Value>::PersistentAVLTree(const PersistentAVLTree& other) :
+    root_(other.root_),
+    count_(other.count_)
+{
+    retain(root_);
+}
+
+template<typename Key, typename Value>
+PersistentAVLTree<Key, Value>&
+PersistentAVLTree<Key, Value>::operator=(const PersistentAVLTree& other)
+{
+    retain(other.root_);
+    release(root_);
+    root_ = other.root_;
+    count_ = other.count_;
+    return *this;
+}
+
+template<typename Key, typename Value>
+PersistentAVLTree<Key, Value>::~PersistentAVLTree()
+{
+    release(root_);
+}
+
+/**
+* Returns a version frozen at the current contents. Later changes to
+* either tree do not show in the other.
+*/
+template<typename Key, typename Value>
+PersistentAVLTree<Key, Value> PersistentAVLTree<Key, Value>::snapshot() const
+{
+    return PersistentAVLTree(*this);
+}
+
+template<typename Key, typename Value>
+bool PersistentAVLTree<Key, Value>::empty() const
+{
+    return root_ == NULL;
+}
+
+template<typename Key, typename Value>
+std::size_t PersistentAVLTree<Key, Value>::size() const
+{
+    return count_;
+}
+
+template<typename Key, typename Value>
+typename PersistentAVLTree<Key, Value>::iterator
+PersistentAVLTree<Key, Value>::begin() const
+{
+    iterator it;
+    it.pushLeftSpine(root_);
+    return it;
+}
+
+template<typename Key, typename Value>
+typename PersistentAVLTree<Key, Value>::iterator
+PersistentAVLTree<Key, Value>::end() const
+{
+    return iterator();
+}
+
+/**
+* Returns an iterator to the item with the given key, or the end
+* iterator if it does not exist. The stack keeps the ancestors the
+* search turned left at, which are the ones iteration visits next.
+*/
+template<typename Key, typename Value>
+typename PersistentAVLTree<Key, Value>::iterator
+PersistentAVLTree<Key, Value>::find(const Key& key) const
+{
+    iterator it;
+    const PNode* curr = root_;
+    while (curr != NULL){
+      if (key < curr->item_.first){
+        it.path_.push_back(curr);
+        curr = curr->left_;
+      }
+      else if (curr->item_.first < key){
+        curr = curr->right_;
+      }
+      else {
+        it.path_.push_back(curr);
+        return it;
+      }
+    }
+    return end();
+}
+
+/**
+ * @precondition The key exists in the map
+ * Returns the value associated with the key
+ */
+template<typename Key, typename Value>
+Value const & PersistentAVLTree<Key, Value>::operator[](const Key& key) const
+{
+    iterator it = find(key);
+    if (it == end()) throw std::out_of_range("Invalid key");
+    return it->second;
+}
+
+/**
+* Inserts the pair, overwriting the value if the key is already present.
+*/
+template<typename Key, typename Value>
+void PersistentAVLTree<Key, Value>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    bool inserted = false;
+    root_ = insertHelper(root_, keyValuePair, inserted);
+    if (inserted){
+      ++count_;
+    }
+}
+
+/**
+* Removes the key if present. A missing key is looked up first so no
+* nodes are copied for it.
+*/
+template<typename Key, typename Value>
+void PersistentAVLTree<Key, Value>::remove(const Key& key)
+{
+    if (find(key) == end()){
+      return;
+    }
+    root_ = removeHelper(root_, key);
+    --count_;
+}
+
+/**
+* Drops this version's nodes; ones shared with other versions live on.
+*/
+template<typename Key, typename Value>
+void PersistentAVLTree<Key, Value>::clear()
+{
+    release(root_);
+    root_ = NULL;
+    count_ = 0;
+}
+
+template<typename Key, typename Value>
+bool PersistentAVLTree<Key, Value>::isBalanced() const
+{
+    return isBalancedHelper(root_) >= 0;
+}
+
+/**
+* Returns the height of the subtree, or -1 if any node in it is out of
+* balance or has a stale height
+*/
+template<typename Key, typename Value>
+int PersistentAVLTree<Key, Value>::isBalancedHelper(const PNode* n)
+{
+    if (n == NULL){
+      return 0;
+    }
+    int left = isBalancedHelper(n->left_);
+    int right = isBalancedHelper(n->right_);
+    if (left < 0 || right < 0 || std::abs(left - right) > 1){
+      return -1;
+    }
+    int h = 1 + std::max(left, right);
+    return (h == n->height_) ? h : -1;
+}
+
+template<typename Key, typename Value>
+void PersistentAVLTree<Key, Value>::retain(PNode* n)
+{
+    if (n != NULL){
+      n->refs_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+/**
+* Drops one reference to n, freeing it and releasing its children when
+* it was the last one.
+*/
+template<typename Key, typename Value>
+void PersistentAVLTree<Key, Value>::release(PNode* n)
+{
+    if (n != NULL && n->refs_.fetch_sub(1, std::memory_order_acq_rel) == 1){
+      release(n->left_);
+      release(n->right_);
+      delete n;
+    }
+}
+
+/**
+* Takes over the caller's reference to n and returns a node with the
+* same contents that the caller owns outright and may change: n itself
+* if nothing else points at it, otherwise a fresh copy.
+*/
+template<typename Key, typename Value>
+typename PersistentAVLTree<Key, Value>::PNode*
+PersistentAVLTree<Key, Value>::makeUnique(PNode* n)
+{
+    if (n->refs_.load(std::memory_order_acquire) == 1){
+      return n;
+    }
+    PNode* copy = new PNode(*n);
+    release(n);
+    return copy;
+}
+
+template<typename Key, typename Value>
+int PersistentAVLTree<Key, Value>::height(const PNode* n)
+{
+    return (n == NULL) ? 0 : n->height_;
+}
+
+/**
+* Restores the height of the uniquely owned node n, and the AVL property
+* with one or two rotations if its children now differ in height by 2.
+* Returns the new root of the subtree.
+*/
+template<typename Key, typename Value>
+typename PersistentAVLTree<Key, Value>::PNode*
+PersistentAVLTree<Key, Value>::rebalance(PNode* n)
+{
+    int balance = height(n->right_) - height(n->left_);
+    if (balance > 1){
+      if (height(n->right_->left_) > height(n->right_->right_)){
+        n->right_ = rotateRight(makeUnique(n->right_));
+      }
+      return rotateLeft(n);
+    }
+    if (balance < -1){
+      if (height(n->left_->right_) > height(n->left_->left_)){
+        n->left_ = rotateLeft(makeUnique(n->left_));
+      }
+      return rotateRight(n);
+    }
+    n->height_ = 1 + std::max(height(n->left_), height(n->right_));
+    return n;
+}
+
+/**
+* Lifts the right child of n above it. n must be uniquely owned; the
+* child is made so before it changes.
+*/
+template<typename Key, typename Value>
+typename PersistentAVLTree<Key, Value>::PNode*
+PersistentAVLTree<Key, Value>::rotateLeft(PNode* n)
+{
+    PNode* r = makeUnique(n->right_);
+    n->right_ = r->left_;
+    n->height_ = 1 + std::max(height(n->left_), height(n->right_));
+    r->left_ = n;
+    r->height_ = 1 + std::max(height(r->left_), height(r->right_));
+    return r;
+}
+
+/**
+* Lifts the left child of n above it. n must be uniquely owned; the
+* child is made so before it changes.
+*/
+template<typename Key, typename Value>
+typename PersistentAVLTree<Key, Value>::PNode*
+PersistentAVLTree<Key, Value>::rotateRight(PNode* n)
+{
+    PNode* l = makeUnique(n->left_);
+    n->left_ = l->right_;
+    n->height_ = 1 + std::max(height(n->left_), height(n->right_));
+    l->right_ = n;
+    l->height_ = 1 + std::max(height(l->left_), height(l->right_));
+    return l;
+}
+
+/**
+* Inserts item below n, taking over the caller's reference to n and
+* returning the owned root of the updated subtree.
+*/
+template<typename Key, typename Value>
+typename PersistentAVLTree<Key, Value>::PNode*
+PersistentAVLTree<Key, Value>::insertHelper(PNode* n, const std::pair<const Key, Value>& item, bool& inserted)
+{
+    if (n == NULL){
+      inserted = true;
+      return new PNode(item);
+    }
+    n = makeUnique(n);
+    if (item.first < n->item_.first){
+      n->left_ = insertHelper(n->left_, item, inserted);
+    }
+    else if (n->item_.first < item.first){
+      n->right_ = insertHelper(n->right_, item, inserted);
+    }
+    else {
+      n->item_.second = item.second;
+      return n;
+    }
+    return rebalance(n);
+}
+
+/**
+* Removes key, which must be present, from below n. Takes over the
+* caller's reference to n and returns the owned root of the result.
+*/
+template<typename Key, typename Value>
+typename PersistentAVLTree<Key, Value>::PNode*
+PersistentAVLTree<Key, Value>::removeHelper(PNode* n, const Key& key)
+{
+    n = makeUnique(n);
+    if (key < n->item_.first){
+      n->left_ = removeHelper(n->left_, key);
+      return rebalance(n);
+    }
+    if (n->item_.first < key){
+      n->right_ = removeHelper(n->right_, key);
+      return rebalance(n);
+    }
+    PNode* left = n->left_;
+    PNode* right = n->right_;
+    n->left_ = NULL;
+    n->right_ = NULL;
+    release(n);
+    if (left == NULL){
+      return right;
+    }
+    if (right == NULL){
+      return left;
+    }
+    // the smallest key on the right takes the removed node's place
+    PNode* smallest = NULL;
+    right = detachSmallest(right, smallest);
+    smallest->left_ = left;
+    smallest->right_ = right;
+    return rebalance(smallest);
+}
+
+/**
+* Unlinks the smallest node below n and hands it back, uniquely owned,
+* through smallest. Takes over the caller's reference to n and returns
+* the owned root of what remains.
+*/
+template<typename Key, typename Value>
+typename PersistentAVLTree<Key, Value>::PNode*
+PersistentAVLTree<Key, Value>::detachSmallest(PNode* n, PNode*& smallest)
+{
+    n = makeUnique(n);
+    if (n->left_ == NULL){
+      PNode* right = n->right_;
+      n->right_ = NULL;
+      smallest = n;
+      return right;
+    }
+    n->left_ = detachSmallest(n->left_, smallest);
+    return rebalance(n);
+}
+
+/*
+---------------------------------------------------
+End implementations for the PersistentAVLTree class.
+---------------------------------------------------
+*/
+
+#endif
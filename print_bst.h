@@ -17,8 +17,8 @@
 // 1 means that it is the root.
 // Returns -1 (not found) if the distance is more than PPBST_MAX_HEIGHT,
 // or -2 if the tree is inconsistent.
-template<typename Key, typename Value>
-int getNodeDepth(BinarySearchTree<Key, Value> const & tree, Node<Key, Value> * root, Node<Key, Value> * node)
+template<typename Key, typename Value, typename Compare, typename Alloc>
+int getNodeDepth(BinarySearchTree<Key, Value, Compare, Alloc> const & tree, Node<Key, Value> * root, Node<Key, Value> * node)
 {
     int dist = 1;
 
@@ -42,25 +42,39 @@ int getNodeDepth(BinarySearchTree<Key, Value> const & tree, Node<Key, Value> * r
 }
 
 // Returns the height of the subtree at root.
-// Uses recursion, not height values, so it is bulletproof
-// against incorrect heights.
-// Stops recursing after PPBST_MAX_HEIGHT calls.
+// Walks the tree level by level, not height values, so it is
+// bulletproof against incorrect heights.
+// Stops after PPBST_MAX_HEIGHT levels.
 template<typename Key, typename Value>
-int getSubtreeHeight(Node<Key, Value> * root, int recursionDepth = 1)
+int getSubtreeHeight(Node<Key, Value> * root)
 {
-    if(root == nullptr)
+    std::vector<Node<Key, Value> *> level;
+    if(root != nullptr)
     {
-        return 0;
+        level.push_back(root);
     }
 
-    if(recursionDepth > PPBST_MAX_HEIGHT)
+    int height = 0;
+    // bail out after PPBST_MAX_HEIGHT levels to prevent infinite loops on bad trees
+    while(!level.empty() && height < PPBST_MAX_HEIGHT)
     {
-        // bail out to prevent infinite loops on bad trees
-        return 0;
+        ++height;
+        std::vector<Node<Key, Value> *> nextLevel;
+        for(size_t i = 0; i < level.size(); ++i)
+        {
+            if(level[i]->getLeft() != nullptr)
+            {
+                nextLevel.push_back(level[i]->getLeft());
+            }
+            if(level[i]->getRight() != nullptr)
+            {
+                nextLevel.push_back(level[i]->getRight());
+            }
+        }
+        level.swap(nextLevel);
     }
 
-    return std::max(getSubtreeHeight(root->getLeft(), recursionDepth + 1),
-                    getSubtreeHeight(root->getRight(), recursionDepth + 1)) + 1;
+    return height;
 }
 
 /* Function to prettily print a BST out to the terminal.
@@ -92,8 +106,8 @@ int getSubtreeHeight(Node<Key, Value> * root, int recursionDepth = 1)
 
     */
 
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::printRoot (Node<Key, Value>* root) const
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::printRoot (Node<Key, Value>* root) const
 {
     // special case for empty trees:
     if(root == nullptr)
@@ -127,10 +141,10 @@ void BinarySearchTree<Key, Value>::printRoot (Node<Key, Value>* root) const
 
     // get placeholders
     // ----------------------------------------------------------------------
-    std::map<Key, uint8_t> valuePlaceholders;
+    std::map<Key, uint8_t, Compare> valuePlaceholders;
 
     uint8_t nextPlaceHolderVal = 1;
-    for(typename BinarySearchTree<Key, Value>::iterator treeIter = this->begin(); treeIter != this->end(); ++treeIter)
+    for(typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator treeIter = this->begin(); treeIter != this->end(); ++treeIter)
     {
 
         if(getNodeDepth(*this, root, treeIter.current_) != -1)
@@ -265,7 +279,7 @@ void BinarySearchTree<Key, Value>::printRoot (Node<Key, Value>* root) const
     if(!std::is_same<Key, uint8_t>::value) // print placeholder explanations if needed:
     {
         std::cout << "Tree Placeholders:------------------" << std::endl;
-        for(typename std::map<Key, uint8_t>::iterator placeholdersIter = valuePlaceholders.begin(); placeholdersIter != valuePlaceholders.end(); ++placeholdersIter)
+        for(typename std::map<Key, uint8_t, Compare>::iterator placeholdersIter = valuePlaceholders.begin(); placeholdersIter != valuePlaceholders.end(); ++placeholdersIter)
         {
             std::cout << '[' << std::setfill('0') << std::setw(2) << ((uint16_t)placeholdersIter->second) << "] -> ";
 
@@ -273,7 +287,7 @@ void BinarySearchTree<Key, Value>::printRoot (Node<Key, Value>* root) const
             std::cout.flags(origCoutState);
             std::cout << '(' << placeholdersIter->first << ", ";
 
-            typename BinarySearchTree<Key, Value>::iterator elementIter = this->find(placeholdersIter->first);
+            typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator elementIter = this->find(placeholdersIter->first);
             if(elementIter == this->end())
             {
                 std::cout << "<error: lookup failed>";
@@ -0,0 +1,473 @@
+#ifndef RBBST_H
+#define RBBST_H
+
+#include <cstdint>
+#include <utility>
+#include "bst.h"
+
+/**
+* A node for a red-black tree. The colour takes one byte, the same slot
+* the balance takes in an AVLNode, and only its low bit means anything
+* outside a bulk build. A bulk build stores the node's subtree height in
+* the other bits (see RBTree::createBuiltNode) and leaves it there; it
+* is stale from then on, until setRed() next rewrites the byte.
+*/
+template <typename Key, typename Value>
+class RBNode : public Node<Key, Value>
+{
+public:
+    template<typename K, typename V>
+    RBNode(K&& key, V&& value, RBNode<Key, Value>* parent);
+    ~RBNode();
+
+    bool isRed() const;
+    void setRed(bool red);
+    int getBuiltHeight() const;
+    void setBuiltHeight(int height);
+
+    // Getters for parent, left, and right that return RBNodes; see the
+    // Node class in bst.h.
+    RBNode<Key, Value>* getParent() const;
+    RBNode<Key, Value>* getLeft() const;
+    RBNode<Key, Value>* getRight() const;
+
+protected:
+    uint8_t color_;     // low bit set for red; the rest only matters during a bulk build
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the RBNode class.
+  -------------------------------------------------
+*/
+
+/**
+* An explicit constructor to initialize the elements by calling the base
+* class constructor. New nodes are red.
+*/
+template<class Key, class Value>
+template<typename K, typename V>
+RBNode<Key, Value>::RBNode(K&& key, V&& value, RBNode<Key, Value>* parent) :
+    Node<Key, Value>(std::forward<K>(key), std::forward<V>(value), parent), color_(1)
+{
+
+}
+
+/**
+* A destructor which does nothing.
+*/
+template<class Key, class Value>
+RBNode<Key, Value>::~RBNode()
+{
+
+}
+
+/**
+* True if the node is red.
+*/
+template<class Key, class Value>
+bool RBNode<Key, Value>::isRed() const
+{
+    return (color_ & 1) != 0;
+}
+
+/**
+* Colours the node red or black.
+*/
+template<class Key, class Value>
+void RBNode<Key, Value>::setRed(bool red)
+{
+    color_ = red ? 1 : 0;
+}
+
+/**
+* The subtree height a bulk build recorded for this node.
+*/
+template<class Key, class Value>
+int RBNode<Key, Value>::getBuiltHeight() const
+{
+    return color_ >> 1;
+}
+
+/**
+* Records the subtree height of a bulk-built node, keeping its colour.
+*/
+template<class Key, class Value>
+void RBNode<Key, Value>::setBuiltHeight(int height)
+{
+    color_ = (uint8_t)((height << 1) | (color_ & 1));
+}
+
+/**
+* A getter for the parent. Every node in an RBTree is an RBNode, so the
+* static_cast is free and the call inlines.
+*/
+template<class Key, class Value>
+RBNode<Key, Value>* RBNode<Key, Value>::getParent() const
+{
+    return static_cast<RBNode<Key, Value>*>(this->parent_);
+}
+
+/**
+* Hidden for the same reasons as above.
+*/
+template<class Key, class Value>
+RBNode<Key, Value>* RBNode<Key, Value>::getLeft() const
+{
+    return static_cast<RBNode<Key, Value>*>(this->left_);
+}
+
+/**
+* Hidden for the same reasons as above.
+*/
+template<class Key, class Value>
+RBNode<Key, Value>* RBNode<Key, Value>::getRight() const
+{
+    return static_cast<RBNode<Key, Value>*>(this->right_);
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the RBNode class.
+  -----------------------------------------------
+*/
+
+/*
+* A red-black tree (Guibas and Sedgewick; the fix-ups follow Cormen et
+* al.). Every path from a node down to a missing child passes the same
+* number of black nodes and no red node has a red child, so the tree is
+* at most 2 log2(n + 1) deep, somewhat deeper than an AVL tree. In
+* exchange an insert makes at most two rotations and a remove at most
+* three, however far up the recolouring goes, where an AVLTree remove
+* may rotate at every level of the path.
+*/
+template <class Key, class Value, class Compare = std::less<Key>, class Alloc = NodePool>
+class RBTree : public BinarySearchTree<Key, Value, Compare, Alloc>
+{
+public:
+    RBTree();
+    explicit RBTree(const Compare& comp);
+    template<typename InputIt>
+    RBTree(InputIt first, InputIt last, const Compare& comp = Compare());
+    RBTree(RBTree&& other);
+    RBTree& operator=(RBTree&& other);
+    virtual ~RBTree();
+    virtual void remove(const Key& key);
+protected:
+    virtual Node<Key, Value>* internalInsert(const Key& key, const Value& value, bool overwrite, bool& inserted);
+    virtual Node<Key, Value>* internalInsert(Key&& key, Value&& value, bool overwrite, bool& inserted);
+    template<typename K, typename V>
+    Node<Key, Value>* insertItem(K&& key, V&& value, bool overwrite, bool& inserted);
+    virtual void destroyNode(Node<Key, Value>* n);
+    virtual Node<Key, Value>* createBuiltNode(Alloc& alloc, const Key& key, const Value& value, Node<Key, Value>* parent,
+                                              int8_t balance, int height) const;
+    RBNode<Key, Value>* root() const;
+    virtual void nodeSwap(RBNode<Key, Value>* n1, RBNode<Key, Value>* n2);
+    static bool isRed(RBNode<Key, Value>* n);
+    void insertFix(RBNode<Key, Value>* n);
+    void removeFix(RBNode<Key, Value>* parent, bool leftShort);
+};
+
+/*
+  --------------------------------------------
+  Begin implementations for the RBTree class.
+  --------------------------------------------
+*/
+
+template<class Key, class Value, class Compare, class Alloc>
+RBTree<Key, Value, Compare, Alloc>::RBTree()
+{
+
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+RBTree<Key, Value, Compare, Alloc>::RBTree(const Compare& comp) :
+    BinarySearchTree<Key, Value, Compare, Alloc>(comp)
+{
+
+}
+
+/*
+ * Range constructor; builds a perfectly balanced tree with its colours
+ * already set. See BinarySearchTree::assign() and createBuiltNode().
+ */
+template<class Key, class Value, class Compare, class Alloc>
+template<typename InputIt>
+RBTree<Key, Value, Compare, Alloc>::RBTree(InputIt first, InputIt last, const Compare& comp) :
+    BinarySearchTree<Key, Value, Compare, Alloc>(comp)
+{
+    this->assign(first, last);
+}
+
+/*
+ * Move constructor; takes over other's nodes in O(1) and leaves other empty.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+RBTree<Key, Value, Compare, Alloc>::RBTree(RBTree&& other) :
+    BinarySearchTree<Key, Value, Compare, Alloc>(std::move(other))
+{
+
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+RBTree<Key, Value, Compare, Alloc>& RBTree<Key, Value, Compare, Alloc>::operator=(RBTree&& other)
+{
+    BinarySearchTree<Key, Value, Compare, Alloc>::operator=(std::move(other));
+    return *this;
+}
+
+/*
+ * Clears here rather than in ~BinarySearchTree so nodes are released
+ * through the RBNode version of destroyNode.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+RBTree<Key, Value, Compare, Alloc>::~RBTree()
+{
+    this->clear();
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+void RBTree<Key, Value, Compare, Alloc>::destroyNode(Node<Key, Value>* n)
+{
+    this->destroyNodeAs(static_cast<RBNode<Key, Value>*>(n));
+}
+
+/*
+ * A bulk-built tree is height-balanced like an AVL tree, which can be
+ * coloured red-black by height alone: counting a leaf as height 1, a
+ * node is red when its height is odd and its parent's is even. The
+ * parent's height is read back from the parent's colour byte, where it
+ * was recorded when the parent was made; the parent is always made
+ * before its children, also when the build is split across threads.
+ * Nothing clears the heights afterwards: only isRed() is read outside a
+ * build, and it looks at the low bit alone.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+Node<Key, Value>* RBTree<Key, Value, Compare, Alloc>::createBuiltNode(
+    Alloc& alloc, const Key& key, const Value& value, Node<Key, Value>* parent, int8_t, int height) const
+{
+    RBNode<Key, Value>* p = static_cast<RBNode<Key, Value>*>(parent);
+    RBNode<Key, Value>* n = this->template constructNode<RBNode<Key, Value> >(alloc, key, value, p);
+    n->setRed(p != nullptr && height % 2 == 1 && p->getBuiltHeight() % 2 == 0);
+    n->setBuiltHeight(height);
+    return n;
+}
+
+/*
+ * The root as an RBNode; every node in this tree is one.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+RBNode<Key, Value>* RBTree<Key, Value, Compare, Alloc>::root() const
+{
+    return static_cast<RBNode<Key, Value>*>(this->root_);
+}
+
+/*
+ * Missing children count as black.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+bool RBTree<Key, Value, Compare, Alloc>::isRed(RBNode<Key, Value>* n)
+{
+    return n != nullptr && n->isRed();
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+Node<Key, Value>* RBTree<Key, Value, Compare, Alloc>::internalInsert(
+    const Key& key, const Value& value, bool overwrite, bool& inserted) {
+    return insertItem(key, value, overwrite, inserted);
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+Node<Key, Value>* RBTree<Key, Value, Compare, Alloc>::internalInsert(
+    Key&& key, Value&& value, bool overwrite, bool& inserted) {
+    return insertItem(std::move(key), std::move(value), overwrite, inserted);
+}
+
+/*
+ * A new key goes in as a red leaf, then insertFix repairs a red parent.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+template<typename K, typename V>
+Node<Key, Value>* RBTree<Key, Value, Compare, Alloc>::insertItem(
+    K&& key, V&& value, bool overwrite, bool& inserted) {
+    RBNode<Key, Value>* current = root();
+    RBNode<Key, Value>* parent = nullptr;
+    bool goLeft = false;
+    while (current != nullptr) {
+        this->count(OperationCounts::NODES_VISITED);
+        parent = current;
+        int c = this->compareKeys(key, current->getKey());
+        if (c < 0) {
+            goLeft = true;
+            current = current->getLeft();
+        } else if (c > 0) {
+            goLeft = false;
+            current = current->getRight();
+        } else {
+            if (overwrite) {
+                current->setValue(std::forward<V>(value));
+            }
+            inserted = false;
+            return current;
+        }
+    }
+    inserted = true;
+    RBNode<Key, Value>* newNode = this->template createNode<RBNode<Key, Value> >(
+        std::forward<K>(key), std::forward<V>(value), parent);
+    if (parent == nullptr) {
+        newNode->setRed(false);
+        this->root_ = newNode;
+        return newNode;
+    }
+    if (goLeft) {
+        parent->setLeft(newNode);
+    } else {
+        parent->setRight(newNode);
+    }
+    this->adjustPathSizes(parent, 1);
+    insertFix(newNode);
+    return newNode;
+}
+
+/*
+ * n is red. While its parent is red too: with a red uncle, the parent
+ * and uncle turn black and the grandparent red, and the check moves two
+ * levels up; with a black uncle, one or two rotations under the
+ * grandparent end it.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+void RBTree<Key, Value, Compare, Alloc>::insertFix(RBNode<Key, Value>* n) {
+    RBNode<Key, Value>* p = n->getParent();
+    while (isRed(p)) {
+        RBNode<Key, Value>* g = p->getParent();
+        bool parentLeft = (g->getLeft() == p);
+        RBNode<Key, Value>* uncle = parentLeft ? g->getRight() : g->getLeft();
+        if (isRed(uncle)) {
+            p->setRed(false);
+            uncle->setRed(false);
+            g->setRed(true);
+            n = g;
+            p = n->getParent();
+            continue;
+        }
+        if ((p->getLeft() == n) != parentLeft) {
+            // zig-zag: make n the outer child first
+            this->rotateUp(n);
+            n = p;
+            p = n->getParent();
+        }
+        p->setRed(false);
+        g->setRed(true);
+        this->rotateUp(p);
+        break;
+    }
+    root()->setRed(false);
+}
+
+/*
+ * Recall: The writeup specifies that if a node has 2 children you
+ * should swap with the predecessor and then remove.
+ *
+ * Removing a red node, or a black one with a (necessarily red) child to
+ * take its colour, needs nothing more; removing a black leaf leaves its
+ * side one black short, which removeFix repairs.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+void RBTree<Key, Value, Compare, Alloc>::remove(const Key& key) {
+    RBNode<Key, Value>* n = static_cast<RBNode<Key, Value>*>(this->internalFind(key));
+    if (n == nullptr) {
+        return;
+    }
+    if (n->getLeft() != nullptr && n->getRight() != nullptr) {
+        RBNode<Key, Value>* pred = static_cast<RBNode<Key, Value>*>(this->predecessor(n));
+        nodeSwap(n, pred);
+    }
+    RBNode<Key, Value>* child = (n->getLeft() != nullptr) ? n->getLeft() : n->getRight();
+    RBNode<Key, Value>* parent = n->getParent();
+    bool wasLeft = (parent != nullptr && parent->getLeft() == n);
+    if (child != nullptr) {
+        child->setParent(parent);
+    }
+    if (parent == nullptr) {
+        this->root_ = child;
+    } else if (wasLeft) {
+        parent->setLeft(child);
+    } else {
+        parent->setRight(child);
+    }
+    this->adjustPathSizes(parent, -1);
+    if (!n->isRed()) {
+        if (child != nullptr) {
+            child->setRed(false);
+        } else if (parent != nullptr) {
+            removeFix(parent, wasLeft);
+        }
+    }
+    this->destroyNode(n);
+}
+
+/*
+ * The subtree on parent's left (leftShort) or right side has one black
+ * node fewer on every path than the other side. Cases as in Cormen et
+ * al.: a red sibling is rotated up first; a black sibling with black
+ * children turns red and the shortage moves up to parent, unless parent
+ * is red and can absorb it; otherwise one or two rotations end it.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+void RBTree<Key, Value, Compare, Alloc>::removeFix(RBNode<Key, Value>* parent, bool leftShort) {
+    RBNode<Key, Value>* x = leftShort ? parent->getLeft() : parent->getRight();
+    while (parent != nullptr && !isRed(x)) {
+        RBNode<Key, Value>* sibling = leftShort ? parent->getRight() : parent->getLeft();
+        if (sibling->isRed()) {
+            sibling->setRed(false);
+            parent->setRed(true);
+            this->rotateUp(sibling);
+            sibling = leftShort ? parent->getRight() : parent->getLeft();
+        }
+        RBNode<Key, Value>* nearChild = leftShort ? sibling->getLeft() : sibling->getRight();
+        RBNode<Key, Value>* farChild = leftShort ? sibling->getRight() : sibling->getLeft();
+        if (!isRed(nearChild) && !isRed(farChild)) {
+            sibling->setRed(true);
+            x = parent;
+            parent = x->getParent();
+            leftShort = (parent != nullptr && parent->getLeft() == x);
+            continue;
+        }
+        if (!isRed(farChild)) {
+            nearChild->setRed(false);
+            sibling->setRed(true);
+            this->rotateUp(nearChild);
+            farChild = sibling;
+            sibling = nearChild;
+        }
+        sibling->setRed(parent->isRed());
+        parent->setRed(false);
+        farChild->setRed(false);
+        this->rotateUp(sibling);
+        return;
+    }
+    if (x != nullptr) {
+        x->setRed(false);
+    }
+}
+
+/*
+ * Colours belong to positions in the tree, so they are swapped along
+ * with the nodes.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+void RBTree<Key, Value, Compare, Alloc>::nodeSwap(RBNode<Key, Value>* n1, RBNode<Key, Value>* n2)
+{
+    BinarySearchTree<Key, Value, Compare, Alloc>::nodeSwap(n1, n2);
+    bool red1 = n1->isRed();
+    n1->setRed(n2->isRed());
+    n2->setRed(red1);
+}
+
+/*
+  ------------------------------------------
+  End implementations for the RBTree class.
+  ------------------------------------------
+*/
+
+#endif
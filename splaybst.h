@@ -0,0 +1,244 @@
+#ifndef SPLAYBST_H
+#define SPLAYBST_H
+
+#include <stdexcept>
+#include <utility>
+#include "bst.h"
+
+/*
+* A self-adjusting binary search tree (Sleator and Tarjan). Every insert,
+* remove and non-const lookup splays the node it reached to the root with
+* zig, zig-zig and zig-zag rotations, so keys that are used often stay
+* near the top: under a skewed access pattern the hot keys are found in
+* a few steps, and any sequence of m operations costs O(m log n) in all.
+*
+* The nodes are plain Nodes; there is nothing to keep per node. Lookups
+* through a const tree (or the heterogeneous find/lower_bound/upper_bound
+* of BinarySearchTree) leave the shape alone, so a const SplayTree can be
+* read like any other tree.
+*/
+template <class Key, class Value, class Compare = std::less<Key>, class Alloc = NodePool>
+class SplayTree : public BinarySearchTree<Key, Value, Compare, Alloc>
+{
+public:
+    typedef typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator iterator;
+
+    SplayTree();
+    explicit SplayTree(const Compare& comp);
+    template<typename InputIt>
+    SplayTree(InputIt first, InputIt last, const Compare& comp = Compare());
+    SplayTree(SplayTree&& other);
+    SplayTree& operator=(SplayTree&& other);
+    virtual void remove(const Key& key);
+    using BinarySearchTree<Key, Value, Compare, Alloc>::find;
+    iterator find(const Key& key);
+    using BinarySearchTree<Key, Value, Compare, Alloc>::operator[];
+    Value& operator[](const Key& key);
+protected:
+    virtual Node<Key, Value>* internalInsert(const Key& key, const Value& value, bool overwrite, bool& inserted);
+    virtual Node<Key, Value>* internalInsert(Key&& key, Value&& value, bool overwrite, bool& inserted);
+    template<typename K, typename V>
+    Node<Key, Value>* insertItem(K&& key, V&& value, bool overwrite, bool& inserted);
+    Node<Key, Value>* access(const Key& key);
+    void splay(Node<Key, Value>* n);
+};
+
+/*
+  -----------------------------------------------
+  Begin implementations for the SplayTree class.
+  -----------------------------------------------
+*/
+
+template<class Key, class Value, class Compare, class Alloc>
+SplayTree<Key, Value, Compare, Alloc>::SplayTree()
+{
+
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+SplayTree<Key, Value, Compare, Alloc>::SplayTree(const Compare& comp) :
+    BinarySearchTree<Key, Value, Compare, Alloc>(comp)
+{
+
+}
+
+/*
+ * Range constructor; builds a perfectly balanced tree, which is as good
+ * a starting shape as any. See BinarySearchTree::assign().
+ */
+template<class Key, class Value, class Compare, class Alloc>
+template<typename InputIt>
+SplayTree<Key, Value, Compare, Alloc>::SplayTree(InputIt first, InputIt last, const Compare& comp) :
+    BinarySearchTree<Key, Value, Compare, Alloc>(comp)
+{
+    this->assign(first, last);
+}
+
+/*
+ * Move constructor; takes over other's nodes in O(1) and leaves other empty.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+SplayTree<Key, Value, Compare, Alloc>::SplayTree(SplayTree&& other) :
+    BinarySearchTree<Key, Value, Compare, Alloc>(std::move(other))
+{
+
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+SplayTree<Key, Value, Compare, Alloc>& SplayTree<Key, Value, Compare, Alloc>::operator=(SplayTree&& other)
+{
+    BinarySearchTree<Key, Value, Compare, Alloc>::operator=(std::move(other));
+    return *this;
+}
+
+/*
+ * Finds key and splays it to the root; end() if it is missing, in which
+ * case the last node on the search path is splayed instead.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+typename SplayTree<Key, Value, Compare, Alloc>::iterator
+SplayTree<Key, Value, Compare, Alloc>::find(const Key& key)
+{
+    return this->iteratorAt(access(key));
+}
+
+/*
+ * As the const operator[], but splays the key to the root.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+Value& SplayTree<Key, Value, Compare, Alloc>::operator[](const Key& key)
+{
+    Node<Key, Value>* n = access(key);
+    if (n == nullptr) throw std::out_of_range("Invalid key");
+    return n->getValue();
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+Node<Key, Value>* SplayTree<Key, Value, Compare, Alloc>::internalInsert(
+    const Key& key, const Value& value, bool overwrite, bool& inserted) {
+    return insertItem(key, value, overwrite, inserted);
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+Node<Key, Value>* SplayTree<Key, Value, Compare, Alloc>::internalInsert(
+    Key&& key, Value&& value, bool overwrite, bool& inserted) {
+    return insertItem(std::move(key), std::move(value), overwrite, inserted);
+}
+
+/*
+ * The plain BinarySearchTree insert, then the new (or overwritten) node
+ * is splayed to the root.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+template<typename K, typename V>
+Node<Key, Value>* SplayTree<Key, Value, Compare, Alloc>::insertItem(
+    K&& key, V&& value, bool overwrite, bool& inserted) {
+    Node<Key, Value>* n = BinarySearchTree<Key, Value, Compare, Alloc>::insertItem(
+        std::forward<K>(key), std::forward<V>(value), overwrite, inserted);
+    splay(n);
+    return n;
+}
+
+/*
+ * Removes key as BinarySearchTree does: a node with two children first
+ * trades places with its predecessor (nodeSwap), then the node is
+ * unlinked. The removed node's parent is splayed afterwards, or, if the
+ * key is missing, the last node the search reached.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+void SplayTree<Key, Value, Compare, Alloc>::remove(const Key& key) {
+    Node<Key, Value>* n = this->root_;
+    Node<Key, Value>* last = nullptr;
+    while (n != nullptr) {
+        this->count(OperationCounts::NODES_VISITED);
+        int c = this->compareKeys(key, n->getKey());
+        if (c == 0) {
+            break;
+        }
+        last = n;
+        n = (c < 0) ? n->getLeft() : n->getRight();
+    }
+    if (n == nullptr) {
+        if (last != nullptr) {
+            splay(last);
+        }
+        return;
+    }
+    if (n->getLeft() != nullptr && n->getRight() != nullptr) {
+        this->nodeSwap(n, this->predecessor(n));
+    }
+    Node<Key, Value>* child = (n->getLeft() != nullptr) ? n->getLeft() : n->getRight();
+    Node<Key, Value>* parent = n->getParent();
+    if (child != nullptr) {
+        child->setParent(parent);
+    }
+    if (parent == nullptr) {
+        this->root_ = child;
+    } else if (parent->getLeft() == n) {
+        parent->setLeft(child);
+    } else {
+        parent->setRight(child);
+    }
+    this->adjustPathSizes(parent, -1);
+    this->destroyNode(n);
+    if (parent != nullptr) {
+        splay(parent);
+    }
+}
+
+/*
+ * Searches for key and splays the node holding it, or the last node on
+ * the search path if there is none. Returns the node holding key or
+ * nullptr.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+Node<Key, Value>* SplayTree<Key, Value, Compare, Alloc>::access(const Key& key) {
+    Node<Key, Value>* n = this->root_;
+    Node<Key, Value>* last = nullptr;
+    while (n != nullptr) {
+        this->count(OperationCounts::NODES_VISITED);
+        last = n;
+        int c = this->compareKeys(key, n->getKey());
+        if (c < 0) {
+            n = n->getLeft();
+        } else if (c > 0) {
+            n = n->getRight();
+        } else {
+            break;
+        }
+    }
+    if (last != nullptr) {
+        splay(last);
+    }
+    return n;
+}
+
+/*
+ * Rotates n up to the root. Where n and its parent are children on the
+ * same side (zig-zig) the parent goes up first, which is what roughly
+ * halves the depth of every node on the path; otherwise (zig-zag, or
+ * zig at the top) n is rotated up directly.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+void SplayTree<Key, Value, Compare, Alloc>::splay(Node<Key, Value>* n) {
+    while (n->getParent() != nullptr) {
+        Node<Key, Value>* p = n->getParent();
+        Node<Key, Value>* g = p->getParent();
+        if (g != nullptr) {
+            if ((g->getLeft() == p) == (p->getLeft() == n)) {
+                this->rotateUp(p);
+            } else {
+                this->rotateUp(n);
+            }
+        }
+        this->rotateUp(n);
+    }
+}
+
+/*
+  ---------------------------------------------
+  End implementations for the SplayTree class.
+  ---------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,421 @@
+#ifndef TREAPBST_H
+#define TREAPBST_H
+
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include "bst.h"
+
+/**
+* A node for a Treap, which adds a random priority. Every node's priority
+* is at least that of its children.
+*/
+template <typename Key, typename Value>
+class TreapNode : public Node<Key, Value>
+{
+public:
+    template<typename K, typename V>
+    TreapNode(K&& key, V&& value, TreapNode<Key, Value>* parent);
+    ~TreapNode();
+
+    uint32_t getPriority() const;
+    void setPriority(uint32_t priority);
+
+    // Getters for parent, left, and right that return TreapNodes; see the
+    // Node class in bst.h.
+    TreapNode<Key, Value>* getParent() const;
+    TreapNode<Key, Value>* getLeft() const;
+    TreapNode<Key, Value>* getRight() const;
+
+protected:
+    uint32_t priority_;
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the TreapNode class.
+  -------------------------------------------------
+*/
+
+/**
+* An explicit constructor to initialize the elements by calling the base class constructor
+*/
+template<class Key, class Value>
+template<typename K, typename V>
+TreapNode<Key, Value>::TreapNode(K&& key, V&& value, TreapNode<Key, Value>* parent) :
+    Node<Key, Value>(std::forward<K>(key), std::forward<V>(value), parent), priority_(0)
+{
+
+}
+
+/**
+* A destructor which does nothing.
+*/
+template<class Key, class Value>
+TreapNode<Key, Value>::~TreapNode()
+{
+
+}
+
+/**
+* A getter for the priority of a TreapNode.
+*/
+template<class Key, class Value>
+uint32_t TreapNode<Key, Value>::getPriority() const
+{
+    return priority_;
+}
+
+/**
+* A setter for the priority of a TreapNode.
+*/
+template<class Key, class Value>
+void TreapNode<Key, Value>::setPriority(uint32_t priority)
+{
+    priority_ = priority;
+}
+
+/**
+* A getter for the parent. Every node in a Treap is a TreapNode, so the
+* static_cast is free and the call inlines.
+*/
+template<class Key, class Value>
+TreapNode<Key, Value>* TreapNode<Key, Value>::getParent() const
+{
+    return static_cast<TreapNode<Key, Value>*>(this->parent_);
+}
+
+/**
+* Hidden for the same reasons as above.
+*/
+template<class Key, class Value>
+TreapNode<Key, Value>* TreapNode<Key, Value>::getLeft() const
+{
+    return static_cast<TreapNode<Key, Value>*>(this->left_);
+}
+
+/**
+* Hidden for the same reasons as above.
+*/
+template<class Key, class Value>
+TreapNode<Key, Value>* TreapNode<Key, Value>::getRight() const
+{
+    return static_cast<TreapNode<Key, Value>*>(this->right_);
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the TreapNode class.
+  -----------------------------------------------
+*/
+
+/*
+* A randomized search tree (Seidel and Aragon): a binary search tree by
+* key that is also a max-heap by a random priority drawn for each node,
+* which makes its shape that of a tree built by random insertions,
+* O(log n) deep in expectation whatever order the keys come in.
+*
+* Non-const lookups adapt the tree to skewed access, as in the paper's
+* self-adjusting variant: each access draws a new priority for the node
+* it finds and keeps it if it is higher, rotating the node up to restore
+* the heap. A key accessed k times out of m then sits about log(m / k)
+* deep, so hot keys drift towards the root, while a cold access only
+* costs one random draw. Const lookups leave the tree alone.
+*/
+template <class Key, class Value, class Compare = std::less<Key>, class Alloc = NodePool>
+class Treap : public BinarySearchTree<Key, Value, Compare, Alloc>
+{
+public:
+    typedef typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator iterator;
+
+    Treap();
+    explicit Treap(const Compare& comp);
+    template<typename InputIt>
+    Treap(InputIt first, InputIt last, const Compare& comp = Compare());
+    Treap(Treap&& other);
+    Treap& operator=(Treap&& other);
+    virtual ~Treap();
+    virtual void remove(const Key& key);
+    using BinarySearchTree<Key, Value, Compare, Alloc>::find;
+    iterator find(const Key& key);
+    using BinarySearchTree<Key, Value, Compare, Alloc>::operator[];
+    Value& operator[](const Key& key);
+protected:
+    virtual Node<Key, Value>* internalInsert(const Key& key, const Value& value, bool overwrite, bool& inserted);
+    virtual Node<Key, Value>* internalInsert(Key&& key, Value&& value, bool overwrite, bool& inserted);
+    template<typename K, typename V>
+    Node<Key, Value>* insertItem(K&& key, V&& value, bool overwrite, bool& inserted);
+    virtual void destroyNode(Node<Key, Value>* n);
+    virtual Node<Key, Value>* createBuiltNode(Alloc& alloc, const Key& key, const Value& value, Node<Key, Value>* parent,
+                                              int8_t balance, int height) const;
+    TreapNode<Key, Value>* root() const;
+    TreapNode<Key, Value>* access(const Key& key);
+    void siftUp(TreapNode<Key, Value>* n);
+    uint32_t nextPriority();
+
+    uint64_t seed_;  // xorshift64 state for the priorities
+};
+
+/*
+  -------------------------------------------
+  Begin implementations for the Treap class.
+  -------------------------------------------
+*/
+
+template<class Key, class Value, class Compare, class Alloc>
+Treap<Key, Value, Compare, Alloc>::Treap() :
+    seed_(0x9e3779b97f4a7c15ULL)
+{
+
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+Treap<Key, Value, Compare, Alloc>::Treap(const Compare& comp) :
+    BinarySearchTree<Key, Value, Compare, Alloc>(comp),
+    seed_(0x9e3779b97f4a7c15ULL)
+{
+
+}
+
+/*
+ * Range constructor; builds a perfectly balanced tree with heap-ordered
+ * priorities. See BinarySearchTree::assign() and createBuiltNode().
+ */
+template<class Key, class Value, class Compare, class Alloc>
+template<typename InputIt>
+Treap<Key, Value, Compare, Alloc>::Treap(InputIt first, InputIt last, const Compare& comp) :
+    BinarySearchTree<Key, Value, Compare, Alloc>(comp),
+    seed_(0x9e3779b97f4a7c15ULL)
+{
+    this->assign(first, last);
+}
+
+/*
+ * Move constructor; takes over other's nodes in O(1) and leaves other empty.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+Treap<Key, Value, Compare, Alloc>::Treap(Treap&& other) :
+    BinarySearchTree<Key, Value, Compare, Alloc>(std::move(other)),
+    seed_(other.seed_)
+{
+
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+Treap<Key, Value, Compare, Alloc>& Treap<Key, Value, Compare, Alloc>::operator=(Treap&& other)
+{
+    BinarySearchTree<Key, Value, Compare, Alloc>::operator=(std::move(other));
+    seed_ = other.seed_;
+    return *this;
+}
+
+/*
+ * Clears here rather than in ~BinarySearchTree so nodes are released
+ * through the TreapNode version of destroyNode.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+Treap<Key, Value, Compare, Alloc>::~Treap()
+{
+    this->clear();
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+void Treap<Key, Value, Compare, Alloc>::destroyNode(Node<Key, Value>* n)
+{
+    this->destroyNodeAs(static_cast<TreapNode<Key, Value>*>(n));
+}
+
+/*
+ * Bulk-built nodes get priorities that fall from the root down, so the
+ * balanced shape the build chose is already a valid heap: the root takes
+ * the highest priority and each child its parent's less a pseudo-random
+ * step (from the node's address, as this may run on several threads) of
+ * at most 2^25, which leaves room for 127 levels.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+Node<Key, Value>* Treap<Key, Value, Compare, Alloc>::createBuiltNode(
+    Alloc& alloc, const Key& key, const Value& value, Node<Key, Value>* parent, int8_t, int) const
+{
+    TreapNode<Key, Value>* p = static_cast<TreapNode<Key, Value>*>(parent);
+    TreapNode<Key, Value>* n = this->template constructNode<TreapNode<Key, Value> >(
+        alloc, key, value, p);
+    if (p == nullptr) {
+        n->setPriority(UINT32_MAX);
+    } else {
+        uint64_t h = (uint64_t)(uintptr_t)n * 0x9e3779b97f4a7c15ULL;
+        n->setPriority(p->getPriority() - 1 - (uint32_t)(h >> 39));
+    }
+    return n;
+}
+
+/*
+ * The root as a TreapNode; every node in this tree is one.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+TreapNode<Key, Value>* Treap<Key, Value, Compare, Alloc>::root() const
+{
+    return static_cast<TreapNode<Key, Value>*>(this->root_);
+}
+
+/*
+ * Finds key, letting its node move up as described above; end() if it
+ * is missing.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+typename Treap<Key, Value, Compare, Alloc>::iterator
+Treap<Key, Value, Compare, Alloc>::find(const Key& key)
+{
+    return this->iteratorAt(access(key));
+}
+
+/*
+ * As the const operator[], but lets the key's node move up.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+Value& Treap<Key, Value, Compare, Alloc>::operator[](const Key& key)
+{
+    TreapNode<Key, Value>* n = access(key);
+    if (n == nullptr) throw std::out_of_range("Invalid key");
+    return n->getValue();
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+Node<Key, Value>* Treap<Key, Value, Compare, Alloc>::internalInsert(
+    const Key& key, const Value& value, bool overwrite, bool& inserted) {
+    return insertItem(key, value, overwrite, inserted);
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+Node<Key, Value>* Treap<Key, Value, Compare, Alloc>::internalInsert(
+    Key&& key, Value&& value, bool overwrite, bool& inserted) {
+    return insertItem(std::move(key), std::move(value), overwrite, inserted);
+}
+
+/*
+ * A new key goes in as a leaf with a fresh priority and is rotated up
+ * past every ancestor with a lower one; that takes fewer than two
+ * rotations in expectation.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+template<typename K, typename V>
+Node<Key, Value>* Treap<Key, Value, Compare, Alloc>::insertItem(
+    K&& key, V&& value, bool overwrite, bool& inserted) {
+    TreapNode<Key, Value>* current = root();
+    TreapNode<Key, Value>* parent = nullptr;
+    bool goLeft = false;
+    while (current != nullptr) {
+        this->count(OperationCounts::NODES_VISITED);
+        parent = current;
+        int c = this->compareKeys(key, current->getKey());
+        if (c < 0) {
+            goLeft = true;
+            current = current->getLeft();
+        } else if (c > 0) {
+            goLeft = false;
+            current = current->getRight();
+        } else {
+            if (overwrite) {
+                current->setValue(std::forward<V>(value));
+            }
+            inserted = false;
+            return current;
+        }
+    }
+    inserted = true;
+    TreapNode<Key, Value>* newNode = this->template createNode<TreapNode<Key, Value> >(
+        std::forward<K>(key), std::forward<V>(value), parent);
+    newNode->setPriority(nextPriority());
+    if (parent == nullptr) {
+        this->root_ = newNode;
+        return newNode;
+    }
+    if (goLeft) {
+        parent->setLeft(newNode);
+    } else {
+        parent->setRight(newNode);
+    }
+    this->adjustPathSizes(parent, 1);
+    siftUp(newNode);
+    return newNode;
+}
+
+/*
+ * Rotates the node down, always lifting its child with the higher
+ * priority so the heap order holds, until it is a leaf, and then unlinks
+ * it. Swapping with the predecessor, as BinarySearchTree does, would
+ * move the predecessor's priority to a place where it may be too low.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+void Treap<Key, Value, Compare, Alloc>::remove(const Key& key) {
+    TreapNode<Key, Value>* n = static_cast<TreapNode<Key, Value>*>(this->internalFind(key));
+    if (n == nullptr) {
+        return;
+    }
+    while (n->getLeft() != nullptr || n->getRight() != nullptr) {
+        TreapNode<Key, Value>* l = n->getLeft();
+        TreapNode<Key, Value>* r = n->getRight();
+        if (r == nullptr || (l != nullptr && l->getPriority() > r->getPriority())) {
+            this->rotateUp(l);
+        } else {
+            this->rotateUp(r);
+        }
+    }
+    TreapNode<Key, Value>* parent = n->getParent();
+    if (parent == nullptr) {
+        this->root_ = nullptr;
+    } else if (parent->getLeft() == n) {
+        parent->setLeft(nullptr);
+    } else {
+        parent->setRight(nullptr);
+    }
+    this->adjustPathSizes(parent, -1);
+    this->destroyNode(n);
+}
+
+/*
+ * Searches for key; when found, draws a new priority for its node and,
+ * if that is higher, raises the node's priority and rotates it up.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+TreapNode<Key, Value>* Treap<Key, Value, Compare, Alloc>::access(const Key& key) {
+    TreapNode<Key, Value>* n = static_cast<TreapNode<Key, Value>*>(this->internalFind(key));
+    if (n != nullptr) {
+        uint32_t priority = nextPriority();
+        if (priority > n->getPriority()) {
+            n->setPriority(priority);
+            siftUp(n);
+        }
+    }
+    return n;
+}
+
+/*
+ * Rotates n up while its priority is higher than its parent's.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+void Treap<Key, Value, Compare, Alloc>::siftUp(TreapNode<Key, Value>* n) {
+    while (n->getParent() != nullptr && n->getParent()->getPriority() < n->getPriority()) {
+        this->rotateUp(n);
+    }
+}
+
+/*
+ * The next priority from the tree's xorshift64 generator (Marsaglia).
+ * Priorities only need to look random to the keys, so a fixed seed is
+ * fine and makes runs repeatable.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+uint32_t Treap<Key, Value, Compare, Alloc>::nextPriority() {
+    seed_ ^= seed_ << 13;
+    seed_ ^= seed_ >> 7;
+    seed_ ^= seed_ << 17;
+    return (uint32_t)(seed_ >> 32);
+}
+
+/*
+  ---------------------------------------------
+  End implementations for the Treap class.
+  ---------------------------------------------
+*/
+
+#endif
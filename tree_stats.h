@@ -0,0 +1,118 @@
+#ifndef TREE_STATS_H
+#define TREE_STATS_H
+
+#include <atomic>
+#include <cstddef>
+#include <map>
+
+/**
+ * What a search tree has done since it was created or its counts were
+ * last reset. Kept only when BST_STATS is defined; otherwise every
+ * count is compiled out and reads as zero.
+ */
+struct OperationCounts
+{
+    // indexes of the counters a tree keeps
+    enum Kind
+    {
+        COMPARISONS,    // key comparisons (one per three-way comparison)
+        NODES_VISITED,  // nodes stepped through by searches and inserts
+        ROTATIONS,      // single rotations; a double rotation counts two
+        NODE_SWAPS,     // nodeSwap calls when removing a node with two children
+        ALLOCATIONS,    // nodes created
+        DEALLOCATIONS,  // nodes destroyed, including those a clear() frees at once
+        KINDS
+    };
+
+    OperationCounts() :
+        comparisons(0),
+        nodesVisited(0),
+        rotations(0),
+        nodeSwaps(0),
+        allocations(0),
+        deallocations(0)
+    {
+    }
+
+    std::size_t comparisons;
+    std::size_t nodesVisited;
+    std::size_t rotations;
+    std::size_t nodeSwaps;
+    std::size_t allocations;
+    std::size_t deallocations;
+};
+
+/**
+ * The counters behind OperationCounts. Increments are relaxed loads and
+ * stores rather than atomic adds: they cost about what a plain ++ does
+ * and are race-free, but readers sharing a tree (ConcurrentAVLTree) may
+ * lose the odd increment to one another.
+ */
+class OperationCounter
+{
+public:
+    OperationCounter()
+    {
+        reset();
+    }
+
+    void add(OperationCounts::Kind kind, std::size_t by)
+    {
+        counts_[kind].store(counts_[kind].load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+    }
+
+    // Adds other's counts to these, e.g. from a helper tree of a parallel job
+    void merge(const OperationCounter& other)
+    {
+        for (int k = 0; k < OperationCounts::KINDS; ++k) {
+            add(OperationCounts::Kind(k), other.counts_[k].load(std::memory_order_relaxed));
+        }
+    }
+
+    void reset()
+    {
+        for (int k = 0; k < OperationCounts::KINDS; ++k) {
+            counts_[k].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    OperationCounts read() const
+    {
+        OperationCounts c;
+        c.comparisons = counts_[OperationCounts::COMPARISONS].load(std::memory_order_relaxed);
+        c.nodesVisited = counts_[OperationCounts::NODES_VISITED].load(std::memory_order_relaxed);
+        c.rotations = counts_[OperationCounts::ROTATIONS].load(std::memory_order_relaxed);
+        c.nodeSwaps = counts_[OperationCounts::NODE_SWAPS].load(std::memory_order_relaxed);
+        c.allocations = counts_[OperationCounts::ALLOCATIONS].load(std::memory_order_relaxed);
+        c.deallocations = counts_[OperationCounts::DEALLOCATIONS].load(std::memory_order_relaxed);
+        return c;
+    }
+
+private:
+    OperationCounter(const OperationCounter&);
+    OperationCounter& operator=(const OperationCounter&);
+
+    std::atomic<std::size_t> counts_[OperationCounts::KINDS];
+};
+
+/**
+ * The shape of a search tree, from BinarySearchTree::stats().
+ */
+struct TreeStats
+{
+    TreeStats() :
+        size(0),
+        height(0),
+        averageDepth(0)
+    {
+    }
+
+    std::size_t size;
+    std::size_t height;         // levels; 0 for an empty tree
+    double averageDepth;        // mean node depth, the root being at 0
+    // number of nodes with each balance, height(right) - height(left)
+    std::map<long, std::size_t> balanceHistogram;
+    OperationCounts operations;
+};
+
+#endif